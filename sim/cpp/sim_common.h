@@ -17,6 +17,19 @@
 #include <cmath>
 #include <cstdint>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <sstream>
+#include <type_traits>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <sys/resource.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 #include <verilated.h>
 
 //=============================================================================
@@ -80,6 +93,334 @@
 #define WAVE_SAW   0x20
 #define WAVE_PULSE 0x40
 
+//=============================================================================
+// Command Line
+//=============================================================================
+
+/**
+ * @brief Check whether a plusarg flag (e.g. "+explore") was given.
+ *
+ * @param argc  Argument count from main().
+ * @param argv  Argument vector from main().
+ * @param name  Plusarg name without the leading '+'.
+ * @return      true if "+name" or "+name=..." is present.
+ */
+inline bool has_plusarg(int argc, char** argv, const std::string& name) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "+" + name || arg.rfind("+" + name + "=", 0) == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Get the value of a "+name=value" plusarg.
+ *
+ * @param argc  Argument count from main().
+ * @param argv  Argument vector from main().
+ * @param name  Plusarg name without the leading '+'.
+ * @param def   Value returned if the plusarg is not present.
+ * @return      The plusarg value, or def.
+ */
+inline std::string get_plusarg(int argc, char** argv, const std::string& name,
+                               const std::string& def = "") {
+    std::string prefix = "+" + name + "=";
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg.rfind(prefix, 0) == 0) return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+/**
+ * @brief Get a numeric "+name=value" plusarg (decimal or 0x-prefixed hex).
+ */
+inline long get_plusarg_int(int argc, char** argv, const std::string& name, long def) {
+    std::string val = get_plusarg(argc, argv, name);
+    return val.empty() ? def : std::stol(val, nullptr, 0);
+}
+
+//=============================================================================
+// Parallel Execution
+//=============================================================================
+
+/**
+ * @brief Number of worker threads to use (+threads=N, default: all cores).
+ */
+inline unsigned sim_threads(int argc, char** argv) {
+    unsigned hw = std::thread::hardware_concurrency();
+    long n = get_plusarg_int(argc, argv, "threads", hw ? hw : 1);
+    return n > 0 ? (unsigned)n : 1;
+}
+
+/**
+ * @brief Run fn(i) for i in [0, n) on a pool of worker threads.
+ *
+ * Work items are handed out one at a time from a shared counter, so jobs
+ * of uneven length balance across threads. Each worker gets its own
+ * index (0..threads-1) so it can own a private model instance.
+ *
+ * @param n        Number of work items.
+ * @param threads  Number of worker threads.
+ * @param fn       Callable as fn(size_t item, unsigned worker).
+ */
+template <typename Fn>
+void parallel_for(size_t n, unsigned threads, Fn fn) {
+    std::atomic<size_t> next{0};
+    auto worker = [&](unsigned w) {
+        for (size_t i = next++; i < n; i = next++) fn(i, w);
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned w = 1; w < threads; w++) pool.emplace_back(worker, w);
+    worker(0);
+    for (auto& t : pool) t.join();
+}
+
+// Fixed LFSR seed of model check i, so a failing check can be rerun alone
+inline uint32_t check_seed(size_t i) {
+    return 0x1234u + 7919u * (uint32_t)i;
+}
+
+/**
+ * @brief Verify a C++ model on the RTL with n independent checks in parallel.
+ *
+ * Each check builds its own model instance and RTL, so they share nothing
+ * and run on separate threads. A check reports its own mismatch.
+ *
+ * @param n        Number of checks.
+ * @param threads  Number of worker threads.
+ * @param fn       Callable as bool fn(size_t check), true if model and RTL agree.
+ * @return         True if every check passed.
+ */
+template <typename Fn>
+bool check_model_parallel(size_t n, unsigned threads, Fn fn) {
+    std::atomic<bool> ok{true};
+    parallel_for(n, threads, [&](size_t i, unsigned) {
+        if (!fn(i)) ok = false;
+    });
+    return ok;
+}
+
+//=============================================================================
+// Run Statistics
+//=============================================================================
+
+enum SimPhase { PHASE_SETUP, PHASE_EVAL, PHASE_SPI, PHASE_IO, NUM_SIM_PHASES };
+
+inline const char* const SIM_PHASE_NAME[NUM_SIM_PHASES] = {"setup", "eval", "spi", "io"};
+
+/**
+ * @brief Read a free-running cycle counter.
+ *
+ * The TSC on x86 (a few ns per read, no syscall), steady_clock nanoseconds
+ * elsewhere. Counts are converted to seconds against steady_clock over the
+ * whole run, so no calibration delay is needed.
+ */
+inline uint64_t read_cycle_counter() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/**
+ * @brief Wall-clock time split of a single-threaded harness.
+ *
+ * Time is charged to the current phase until the next switch. Phases are
+ * switched per scope (an SPI frame, a block write), never per tick, so the
+ * accounting costs nothing measurable. Everything not claimed by another
+ * phase counts as model evaluation.
+ */
+class SimStats {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Switch to a new phase.
+     * @return  The phase that was active before.
+     */
+    SimPhase enter(SimPhase phase) {
+        uint64_t now = read_cycle_counter();
+        counts[cur] += now - last;
+        last = now;
+        SimPhase prev = cur;
+        cur = phase;
+        return prev;
+    }
+
+    double phase_sec(SimPhase phase) {
+        enter(cur);
+        return counts[phase] / counter_hz();
+    }
+
+    double wall_sec() const {
+        return std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    /**
+     * @brief Peak resident set size of the process in KiB.
+     */
+    static long peak_rss_kb() {
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        return ru.ru_maxrss;
+    }
+
+    /**
+     * @brief Print a one-line progress report with realtime factor and ETA.
+     *
+     * Rewrites the line in place on a terminal and appends a line otherwise.
+     * Throughput excludes setup time so the ETA is not skewed by stimulus
+     * loading.
+     *
+     * @param done   Simulated cycles completed.
+     * @param total  Simulated cycles in the whole run.
+     * @param extra  Optional text appended to the line.
+     */
+    void progress(uint64_t done, uint64_t total, const std::string& extra = "") {
+        SimPhase prev = enter(PHASE_IO);
+        double run_sec = std::max(1e-9, wall_sec() - counts[PHASE_SETUP] / counter_hz());
+        double rate    = done / run_sec;
+        double eta     = (rate > 0 && total > done) ? (total - done) / rate : 0.0;
+
+        char line[160];
+        std::snprintf(line, sizeof(line), "[TB] %.1f s / %.1f s  %3d%%  %.3fx realtime  ETA %d:%02d%s%s",
+                      (double)done / CLK_FREQ_HZ, (double)total / CLK_FREQ_HZ,
+                      (int)(100 * done / std::max<uint64_t>(total, 1)), rate / CLK_FREQ_HZ,
+                      (int)eta / 60, (int)eta % 60, extra.empty() ? "" : "  ", extra.c_str());
+
+        if (tty) {
+            std::cout << '\r' << line << "\x1b[K" << std::flush;
+            line_open = true;
+        } else {
+            std::cout << line << '\n';
+        }
+        enter(prev);
+    }
+
+    /**
+     * @brief Print the phase breakdown.
+     *
+     * @param sim_cycles  Simulated system clock cycles.
+     */
+    void print_report(uint64_t sim_cycles) {
+        if (line_open) std::cout << '\n';
+        line_open = false;
+
+        double wall    = wall_sec();
+        double sim_sec = (double)sim_cycles / CLK_FREQ_HZ;
+        std::printf("[TB] Profile: %.2f s wall, %.3f s simulated, %.3fx realtime, %.2f Mcycles/s, peak RSS %.1f MB\n",
+                    wall, sim_sec, sim_sec / wall, sim_cycles / wall / 1e6, peak_rss_kb() / 1024.0);
+        for (int p = 0; p < NUM_SIM_PHASES; p++) {
+            double sec = phase_sec((SimPhase)p);
+            std::printf("[TB]   %-6s %9.3f s %6.1f %%\n", SIM_PHASE_NAME[p], sec, 100 * sec / wall);
+        }
+        std::fflush(stdout);
+    }
+
+    /**
+     * @brief Write the run statistics as JSON.
+     *
+     * @param path        Output file.
+     * @param name        Bench name.
+     * @param sim_cycles  Simulated system clock cycles.
+     * @return            false if the file could not be opened.
+     */
+    bool write_json(const std::string& path, const std::string& name, uint64_t sim_cycles) {
+        double wall    = wall_sec();
+        double sim_sec = (double)sim_cycles / CLK_FREQ_HZ;
+
+        std::ofstream f(path);
+        if (!f.is_open()) {
+            std::cerr << "[TB] Error: Could not open " << path << std::endl;
+            return false;
+        }
+        f << "{\n"
+          << "  \"name\": \"" << name << "\",\n"
+          << "  \"wall_sec\": " << wall << ",\n"
+          << "  \"sim_cycles\": " << sim_cycles << ",\n"
+          << "  \"sim_sec\": " << sim_sec << ",\n"
+          << "  \"cycles_per_sec\": " << sim_cycles / wall << ",\n"
+          << "  \"realtime_factor\": " << sim_sec / wall << ",\n"
+          << "  \"peak_rss_kb\": " << peak_rss_kb() << ",\n"
+          << "  \"phases\": {";
+        for (int p = 0; p < NUM_SIM_PHASES; p++) {
+            f << (p ? ", " : "") << "\"" << SIM_PHASE_NAME[p] << "\": " << phase_sec((SimPhase)p);
+        }
+        f << "}\n}\n";
+        return true;
+    }
+
+private:
+    double counter_hz() const {
+        return (read_cycle_counter() - start_count) / std::max(1e-9, wall_sec());
+    }
+
+    clock::time_point start       = clock::now();
+    uint64_t          start_count = read_cycle_counter();
+    uint64_t          last        = start_count;
+    SimPhase          cur         = PHASE_EVAL;
+    uint64_t          counts[NUM_SIM_PHASES] = {};
+    bool              tty         = isatty(STDOUT_FILENO);
+    bool              line_open   = false;
+};
+
+/**
+ * @brief Process-wide statistics, constructed before main() so wall time
+ *        covers the whole run.
+ */
+inline SimStats sim_stats;
+
+/**
+ * @brief Charge the enclosing scope to a phase, then restore the previous one.
+ *
+ * sim_stats is one unsynchronized process-wide instance, so builds that run
+ * models on several threads (the shared library, SIM_NO_STATS) compile the
+ * accounting out.
+ */
+#ifndef SIM_NO_STATS
+struct ScopedPhase {
+    SimPhase prev;
+    explicit ScopedPhase(SimPhase phase) : prev(sim_stats.enter(phase)) {}
+    ~ScopedPhase() { sim_stats.enter(prev); }
+};
+#else
+struct ScopedPhase {
+    explicit ScopedPhase(SimPhase) {}
+};
+#endif
+
+/**
+ * @brief Write run statistics if +stats=<path> was given.
+ *
+ * @param argc, argv  Command line.
+ * @param ctx         Verilator context; simulated cycles come from its time.
+ * @param name        Bench name.
+ */
+inline void report_stats(int argc, char** argv, const std::unique_ptr<VerilatedContext>& ctx,
+                         const std::string& name) {
+    std::string path = get_plusarg(argc, argv, "stats");
+    if (path.empty()) return;
+    sim_stats.write_json(path, name, ctx->time() / CLK_PERIOD_NS);
+}
+
+/**
+ * @brief Print the phase breakdown and write it as JSON.
+ *
+ * Used by the top-level harnesses. The JSON goes to +stats=<path>, or
+ * tmp/<name>_profile.json by default.
+ */
+inline void report_profile(int argc, char** argv, const std::unique_ptr<VerilatedContext>& ctx,
+                           const std::string& name) {
+    uint64_t sim_cycles = ctx->time() / CLK_PERIOD_NS;
+    sim_stats.print_report(sim_cycles);
+    sim_stats.write_json(get_plusarg(argc, argv, "stats", "tmp/" + name + "_profile.json"),
+                         name, sim_cycles);
+}
+
 //=============================================================================
 // Utility Functions
 //=============================================================================
@@ -102,6 +443,24 @@ void tick(const std::unique_ptr<VerilatedContext>& ctx,
     ctx->timeInc(CLK_PERIOD_NS / 2);
 }
 
+/**
+ * @brief Run one system clock cycle and dump both edges to a waveform.
+ *
+ * @tparam W  Waveform sink with dump(time) (WaveTrace in sim_trace.h).
+ */
+template <typename T, typename W>
+void tick(const std::unique_ptr<VerilatedContext>& ctx,
+          const std::unique_ptr<T>& top, W& wave) {
+    top->clk_i = 0;
+    top->eval();
+    wave.dump(ctx->time());
+    ctx->timeInc(CLK_PERIOD_NS / 2);
+    top->clk_i = 1;
+    top->eval();
+    wave.dump(ctx->time());
+    ctx->timeInc(CLK_PERIOD_NS / 2);
+}
+
 /**
  * @brief Run multiple system clock cycles.
  *
@@ -119,13 +478,30 @@ void tick_batch(const std::unique_ptr<VerilatedContext>& ctx,
     }
 }
 
+/**
+ * @brief Advance simulation time over idle clock cycles without evaluating.
+ *
+ * Used by sample-driven benches to jump over the idle part of a sample
+ * period. Only valid while the DUT holds its state, i.e. all FSMs are
+ * idle and no start pulse is pending.
+ *
+ * @param ctx    Verilator simulation context.
+ * @param ticks  Number of full clock cycles to skip.
+ */
+inline void skip_ticks(const std::unique_ptr<VerilatedContext>& ctx, uint64_t ticks) {
+    ctx->timeInc(ticks * CLK_PERIOD_NS);
+}
+
 /**
  * @brief PDM capture.
  *
  * Packs 1-bit PDM samples into bytes and streams them to a binary file.
  */
 struct PdmCapture {
+    static constexpr size_t BUF_BYTES = 1 << 16;
+
     std::ofstream file;
+    std::vector<char> buf;
     uint8_t  byte      = 0;
     int      bit_count = 0;
     uint64_t total     = 0;
@@ -137,6 +513,7 @@ struct PdmCapture {
      */
     void open(const std::string& path) {
         file.open(path, std::ios::binary);
+        buf.reserve(BUF_BYTES);
     }
 
     /**
@@ -148,7 +525,8 @@ struct PdmCapture {
         byte = (byte << 1) | (pdm_bit & 1);
         bit_count++;
         if (bit_count == 8) {
-            file.put(static_cast<char>(byte));
+            buf.push_back(static_cast<char>(byte));
+            if (buf.size() >= BUF_BYTES) write_block();
             byte = 0;
             bit_count = 0;
         }
@@ -161,10 +539,155 @@ struct PdmCapture {
     void flush() {
         if (bit_count > 0) {
             byte <<= (8 - bit_count);
-            file.put(static_cast<char>(byte));
+            buf.push_back(static_cast<char>(byte));
         }
+        write_block();
         file.close();
     }
+
+private:
+    void write_block() {
+        ScopedPhase phase(PHASE_IO);
+        file.write(buf.data(), buf.size());
+        buf.clear();
+    }
+};
+
+//=============================================================================
+// Table Output
+//=============================================================================
+
+/**
+ * @brief NumPy dtype string for a column type (little-endian host).
+ */
+template <typename T>
+constexpr const char* npy_descr() {
+    static_assert(std::is_arithmetic<T>::value, "npy column must be arithmetic");
+    if (std::is_floating_point<T>::value) return sizeof(T) == 4 ? "<f4" : "<f8";
+    if (std::is_signed<T>::value) {
+        switch (sizeof(T)) { case 1: return "|i1"; case 2: return "<i2"; case 4: return "<i4"; default: return "<i8"; }
+    }
+    switch (sizeof(T)) { case 1: return "|u1"; case 2: return "<u2"; case 4: return "<u4"; default: return "<u8"; }
+}
+
+/**
+ * @brief Buffered table writer for per-sample bench output.
+ *
+ * Writes a NumPy .npy file holding a packed structured array with one named
+ * field per column; np.load() gives the columns by name. Rows are appended
+ * to a memory buffer and written in large blocks, and the row count in the
+ * header is patched on close. With csv set, writes the same table as CSV.
+ *
+ * @tparam Ts  Column types, in row order.
+ */
+template <typename... Ts>
+class TableWriter {
+public:
+    static constexpr size_t ROW_BYTES = (sizeof(Ts) + ... + 0);
+
+    ~TableWriter() { close(); }
+
+    /**
+     * @brief Create the output file.
+     *
+     * @param base   Path without extension; ".npy" or ".csv" is appended.
+     * @param names  Column names, one per type.
+     * @param csv    Write CSV instead of .npy.
+     * @return       false if the file could not be opened.
+     */
+    bool open(const std::string& base, const std::vector<std::string>& names, bool csv = false) {
+        this->csv = csv;
+        this->names = names;
+        path = base + (csv ? ".csv" : ".npy");
+        file.open(path, std::ios::binary);
+        if (!file.is_open()) return false;
+
+        rows       = 0;
+        header_len = 0;
+        if (csv) {
+            for (size_t i = 0; i < names.size(); i++) file << (i ? "," : "") << names[i];
+            file << "\n";
+        } else {
+            header_len = header(0).size();
+            file << header(0);
+        }
+        buf.reserve(BUF_BYTES);
+        return true;
+    }
+
+    /**
+     * @brief Append one row.
+     */
+    void row(Ts... values) {
+        if (csv) {
+            bool first = true;
+            ((file << (first ? "" : ",") << +values, first = false), ...);
+            file << "\n";
+        } else {
+            (append(values), ...);
+            if (buf.size() >= BUF_BYTES) flush();
+        }
+        rows++;
+    }
+
+    /**
+     * @brief Flush buffered rows, finalize the header and close the file.
+     */
+    void close() {
+        if (!file.is_open()) return;
+        if (!csv) {
+            flush();
+            file.seekp(0);
+            file << header(rows);
+        }
+        file.close();
+    }
+
+    const std::string& filename() const { return path; }
+
+private:
+    static constexpr size_t BUF_BYTES = 1 << 20;
+
+    std::ofstream            file;
+    std::string              path;
+    std::vector<std::string> names;
+    std::vector<char>        buf;
+    uint64_t                 rows       = 0;
+    size_t                   header_len = 0;
+    bool                     csv        = false;
+
+    template <typename T>
+    void append(T v) {
+        const char* p = reinterpret_cast<const char*>(&v);
+        buf.insert(buf.end(), p, p + sizeof(T));
+    }
+
+    void flush() {
+        ScopedPhase phase(PHASE_IO);
+        file.write(buf.data(), buf.size());
+        buf.clear();
+    }
+
+    // npy v1.0 header, padded to a fixed length so it can be rewritten in place
+    std::string header(uint64_t n) const {
+        const char* descr[] = {npy_descr<Ts>()...};
+        std::ostringstream dict;
+        dict << "{'descr': [";
+        for (size_t i = 0; i < sizeof...(Ts); i++) {
+            dict << (i ? ", " : "") << "('" << names[i] << "', '" << descr[i] << "')";
+        }
+        dict << "], 'fortran_order': False, 'shape': (" << n << ",), }";
+
+        std::string d = dict.str();
+        size_t total = header_len ? header_len : ((10 + d.size() + 21 + 63) / 64) * 64;
+        d.append(total - 10 - d.size() - 1, ' ');
+        d += '\n';
+
+        std::string h("\x93NUMPY\x01\x00", 8);
+        h += (char)(d.size() & 0xFF);
+        h += (char)(d.size() >> 8);
+        return h + d;
+    }
 };
 
 /**
@@ -180,6 +703,7 @@ struct PdmCapture {
 template <typename T, typename TickFn>
 void spi_write(const std::unique_ptr<T>& top, TickFn tick_fn,
                uint8_t addr, uint8_t data, int spi_div = 20) {
+    ScopedPhase phase(PHASE_SPI);
     uint16_t frame = 0x8000 | (addr << 8) | data;
     top->cs_i = 0;
     for (int i = 15; i >= 0; i--) {
@@ -3,6 +3,8 @@
 //  File: sim_delta_sigma.cpp
 //  Description: Verilator testbench for the delta-sigma modulator.
 //               Inputs a 1 kHz sine wave and captures the 1-bit PDM output.
+//               With +analyze, measures SNR/THD+N/ENOB over a tone/amplitude grid.
+//               With +dc_sweep, maps idle tones and limit cycles for all DC codes.
 //
 //  Author:
 //    - Andreas Pedersen
@@ -10,18 +12,482 @@
 //-------------------------------------------------------------------------------------------------
 
 #include "sim_common.h"
+#include "sim_dsp.h"
+#include "sim_model.h"
+#include "sim_trace.h"
 #include "Vtb_delta_sigma.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
 const double   TONE_FREQ       = 1000.0;                            // 1 kHz test tone
 const int16_t  AMPLITUDE       = 1024;
 const uint64_t NUM_DAC_SAMPLES = 1 << 20;                           // ~0.1 s at 10 MHz
 const double   DURATION_SEC    = (double)NUM_DAC_SAMPLES / DAC_RATE_HZ;
 
+//=============================================================================
+// Spectral Analysis (+analyze)
+//=============================================================================
+
+const double AUDIO_BAND_HZ = 20000.0;
+const double FULL_SCALE    = 2048.0;    // audio_i * 16 reaches the +/-32768 quantizer level
+const int    LOBE_BINS     = 4;         // Blackman-Harris main lobe half-width
+const double ANALYZE_FREQS[] = {1000.0, 5000.0, 15000.0};
+const double ANALYZE_DBFS[]  = {
+    -60, -50, -40, -30, -20, -10, -6, -3, -2, -1, 0, 1, 2, 3, 4.5, 6, 9, 12
+};
+
+struct ToneMetrics {
+    double freq_hz;
+    int    amp_code;
+    double in_dbfs;
+    double out_dbfs;        // Fundamental level at the PDM output
+    double gain_err_db;     // out - in, corrected for the 50 kHz sample-and-hold droop
+    double snr_db;          // Signal to in-band noise, harmonics excluded
+    double thdn_db;         // In-band noise + harmonics relative to the signal
+    double enob;
+    double slope_db_dec;    // Out-of-band noise shaping slope
+    bool   stable;          // Gain within 1 dB and SNR not collapsed (set by run_analyze)
+};
+
+/**
+ * @brief Drive a held sine at 50 kHz and capture the 10 MHz PDM stream.
+ *
+ * @param n       Number of PDM samples to return (+1/-1).
+ * @param settle  PDM samples to discard first.
+ */
+std::vector<double> capture_tone(double freq, int amp, size_t n, size_t settle) {
+    const std::unique_ptr<VerilatedContext> ctx{new VerilatedContext};
+    ctx->traceEverOn(false);
+    const std::unique_ptr<Vtb_delta_sigma> top{new Vtb_delta_sigma{ctx.get(), "TOP"}};
+
+    top->clk_i         = 0;
+    top->rst_ni        = 0;
+    top->audio_valid_i = 0;
+    top->audio_i       = 0;
+    for (int i = 0; i < 5; i++) tick(ctx, top);
+    top->rst_ni = 1;
+    for (int i = 0; i < 5; i++) tick(ctx, top);
+
+    std::vector<double> pdm;
+    pdm.reserve(n);
+
+    for (uint64_t cycle = 0; pdm.size() < n; cycle++) {
+        if (cycle % CYCLES_PER_SAMPLE == 0) {
+            double t = (double)cycle / CLK_FREQ_HZ;
+            top->audio_valid_i = 1;
+            top->audio_i = (int16_t)std::lround(amp * std::sin(2.0 * M_PI * freq * t));
+        } else {
+            top->audio_valid_i = 0;
+        }
+
+        if (cycle % CYCLES_PER_DAC == 0 && cycle / CYCLES_PER_DAC >= settle) {
+            pdm.push_back(top->wave_o ? 1.0 : -1.0);
+        }
+
+        tick(ctx, top);
+    }
+
+    top->final();
+    return pdm;
+}
+
+/**
+ * @brief Least-squares slope of the noise floor in dB per decade.
+ *
+ * Uses the median bin power of log-spaced bands, which ignores the sparse
+ * tones (harmonics, sample-and-hold images) sitting on top of the noise.
+ */
+double noise_slope(const std::vector<double>& p, double bin_hz, double f_lo, double f_hi) {
+    const int BANDS_PER_DEC = 10;
+    std::vector<double> xs, ys;
+    for (double f = f_lo; f * std::pow(10.0, 1.0 / BANDS_PER_DEC) <= f_hi;
+         f *= std::pow(10.0, 1.0 / BANDS_PER_DEC)) {
+        size_t k0 = (size_t)(f / bin_hz);
+        size_t k1 = (size_t)(f * std::pow(10.0, 1.0 / BANDS_PER_DEC) / bin_hz);
+        if (k1 <= k0 + 4 || k1 >= p.size()) continue;
+
+        std::vector<double> band(p.begin() + k0, p.begin() + k1);
+        std::nth_element(band.begin(), band.begin() + band.size() / 2, band.end());
+        xs.push_back(std::log10(f) + 0.5 / BANDS_PER_DEC);
+        ys.push_back(10.0 * std::log10(band[band.size() / 2] + 1e-30));
+    }
+
+    double n = xs.size(), sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (size_t i = 0; i < xs.size(); i++) {
+        sx += xs[i]; sy += ys[i]; sxx += xs[i] * xs[i]; sxy += xs[i] * ys[i];
+    }
+    return (n * sxy - sx * sy) / (n * sxx - sx * sx);
+}
+
+ToneMetrics analyze_tone(double freq, int amp, size_t n, size_t settle,
+                         const std::vector<double>& window) {
+    std::vector<double> p = power_spectrum(capture_tone(freq, amp, n, settle), window);
+    double bin_hz  = (double)DAC_RATE_HZ / n;
+    size_t band_k  = (size_t)(AUDIO_BAND_HZ / bin_hz);
+
+    // Locate the fundamental near its nominal bin
+    size_t k_nom = (size_t)std::lround(freq / bin_hz);
+    size_t k_sig = k_nom;
+    for (size_t k = k_nom - 2; k <= k_nom + 2; k++) if (p[k] > p[k_sig]) k_sig = k;
+
+    // 0 = noise, 1 = DC/signal (excluded), 2 = harmonic
+    std::vector<uint8_t> mark(band_k + 1, 0);
+    auto mark_lobe = [&](size_t k, uint8_t m) {
+        for (size_t i = (k > LOBE_BINS ? k - LOBE_BINS : 0); i <= k + LOBE_BINS && i <= band_k; i++)
+            if (!mark[i]) mark[i] = m;
+    };
+    mark_lobe(0, 1);
+    mark_lobe(k_sig, 1);
+    for (size_t h = 2; h * k_sig <= band_k + LOBE_BINS; h++) mark_lobe(h * k_sig, 2);
+
+    double signal = 0.0, noise = 0.0, dist = 0.0;
+    size_t noise_bins = 0;
+    for (size_t k = 1; k <= band_k; k++) {
+        if (mark[k] == 0) { noise += p[k]; noise_bins++; }
+        else if (mark[k] == 2) dist += p[k];
+    }
+    for (size_t k = k_sig - LOBE_BINS; k <= k_sig + LOBE_BINS; k++) signal += p[k];
+
+    // Fill in the noise hidden under the excluded lobes
+    noise *= (double)band_k / std::max<size_t>(noise_bins, 1);
+
+    ToneMetrics m;
+    m.freq_hz      = freq;
+    m.amp_code     = amp;
+    m.in_dbfs      = 20.0 * std::log10(amp / FULL_SCALE);
+    m.out_dbfs     = 10.0 * std::log10(2.0 * signal + 1e-30);
+    m.snr_db       = 10.0 * std::log10(signal / noise);
+    m.thdn_db      = 10.0 * std::log10((noise + dist) / signal);
+    m.enob         = (-m.thdn_db - 1.76) / 6.02;
+    m.slope_db_dec = noise_slope(p, bin_hz, 2.0 * AUDIO_BAND_HZ, 1e6);
+
+    double x = M_PI * freq / SAMPLE_RATE_HZ;
+    m.gain_err_db  = m.out_dbfs - m.in_dbfs - 20.0 * std::log10(std::sin(x) / x);
+    m.stable       = false;
+    return m;
+}
+
+int run_analyze(int argc, char** argv) {
+    unsigned threads   = sim_threads(argc, argv);
+    int      fft_order = get_plusarg_int(argc, argv, "fft_order", 20);
+    size_t   n         = (size_t)1 << fft_order;
+    size_t   settle    = DAC_RATE_HZ / 200;     // 5 ms
+
+    struct Point { double freq; int amp; };
+    std::vector<Point> points;
+    for (double f : ANALYZE_FREQS) {
+        for (double db : ANALYZE_DBFS) {
+            int amp = (int)std::lround(FULL_SCALE * std::pow(10.0, db / 20.0));
+            points.push_back({f, std::clamp(amp, 1, 8191)});
+        }
+    }
+
+    std::cout << "[TB] Delta-Sigma Spectral Analysis (" << points.size() << " points, "
+              << n << "-point FFT, " << threads << " threads)" << std::endl;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    const std::vector<double> window = blackman_harris(n);
+    std::vector<ToneMetrics> results(points.size());
+    parallel_for(points.size(), threads, [&](size_t i, unsigned) {
+        results[i] = analyze_tone(points[i].freq, points[i].amp, n, settle, window);
+    });
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    // Walk each amplitude ladder upwards. The modulator is overloaded once the
+    // fundamental deviates by more than 1 dB or the SNR drops 10 dB below the
+    // best seen so far; everything above that point counts as unstable.
+    for (double f : ANALYZE_FREQS) {
+        bool   overloaded = false;
+        double best_snr   = -1e9;
+        for (auto& m : results) {
+            if (m.freq_hz != f) continue;
+            overloaded |= std::fabs(m.gain_err_db) > 1.0 || m.snr_db < best_snr - 10.0;
+            best_snr = std::max(best_snr, m.snr_db);
+            m.stable = !overloaded;
+        }
+    }
+
+    std::ofstream csv("tmp/delta_sigma_analysis.csv");
+    if (!csv.is_open()) {
+        std::cerr << "[TB] Error: Could not open " << "tmp/delta_sigma_analysis.csv" << std::endl;
+        return 1;
+    }
+    csv << "freq_hz,amp_code,in_dbfs,out_dbfs,gain_err_db,snr_db,thdn_db,enob,slope_db_dec,stable\n";
+    std::printf("\n[TB]  freq Hz   code   in dBFS  out dBFS   SNR dB  THD+N dB   ENOB  slope dB/dec\n");
+    for (const auto& m : results) {
+        csv << m.freq_hz << "," << m.amp_code << "," << m.in_dbfs << "," << m.out_dbfs << "," << m.gain_err_db << ","
+            << m.snr_db << "," << m.thdn_db << "," << m.enob << "," << m.slope_db_dec << ","
+            << m.stable << "\n";
+        std::printf("[TB] %7.0f %6d %9.1f %9.1f %8.1f %9.1f %6.2f %9.1f%s\n",
+                    m.freq_hz, m.amp_code, m.in_dbfs, m.out_dbfs, m.snr_db, m.thdn_db,
+                    m.enob, m.slope_db_dec, m.stable ? "" : "  UNSTABLE");
+    }
+    csv.close();
+
+    // Peak SNDR and maximum stable input per frequency
+    std::cout << std::endl;
+    double slope_sum = 0.0;
+    int    slope_count = 0;
+    for (double f : ANALYZE_FREQS) {
+        const ToneMetrics* msa  = nullptr;
+        const ToneMetrics* peak = nullptr;
+        for (const auto& m : results) {
+            if (m.freq_hz != f) continue;
+            if (!m.stable) break;
+            slope_sum += m.slope_db_dec;
+            slope_count++;
+            msa = &m;
+            if (!peak || m.thdn_db < peak->thdn_db) peak = &m;
+        }
+        if (!msa) {
+            std::printf("[TB] %5.0f Hz: no stable input level\n", f);
+            continue;
+        }
+        std::printf("[TB] %5.0f Hz: peak SNDR %.1f dB (ENOB %.2f) at %.1f dBFS, "
+                    "max stable input %.1f dBFS (code %d)\n",
+                    f, -peak->thdn_db, peak->enob, peak->in_dbfs, msa->in_dbfs, msa->amp_code);
+    }
+    std::printf("[TB] Mean noise-shaping slope: %.1f dB/decade\n", slope_sum / std::max(slope_count, 1));
+
+    std::cout << "\n[TB] Finished in " << elapsed << " s" << std::endl;
+    std::cout << "[TB] Saved to tmp/delta_sigma_analysis.csv" << std::endl;
+    return 0;
+}
+
+//=============================================================================
+// DC Idle-Tone Sweep (+dc_sweep)
+//=============================================================================
+
+const uint64_t DC_SETTLE_STEPS = 1 << 14;
+const uint64_t DC_MAX_PERIOD   = 1 << 22;   // Give up on periodicity beyond ~0.4 s
+const double   DC_OVERLOAD_CODES = 16.0;
+
+struct DcResult {
+    int      code;
+    double   dc_err;            // Mean output - input, in input codes
+    uint64_t period;            // PDM period in modulator clocks, 0 if not found
+    double   spur_hz;           // Largest in-band spur (DC excluded)
+    double   spur_dbfs;
+    double   inband_dbfs;       // Total in-band power excluding DC
+    bool     overload;          // DC level not reproduced
+    bool     problem;           // Audible idle tone
+};
+
+/**
+ * @brief Check the modulator model against the RTL with random held samples.
+ *
+ * The samples come from check_seed(check), so checks are independent.
+ * With +trace_on=mismatch (TRACE=1 build) the cycles before a mismatch are
+ * dumped to logs/tb_delta_sigma_check.fst.
+ */
+bool check_delta_sigma_model(int argc, char** argv, uint64_t cycles, size_t check) {
+    const bool trace = has_plusarg(argc, argv, "trace_on");
+    const std::unique_ptr<VerilatedContext> ctx{new VerilatedContext};
+    ctx->traceEverOn(trace);
+    const std::unique_ptr<Vtb_delta_sigma> top{new Vtb_delta_sigma{ctx.get(), "TOP"}};
+
+    WaveTrace<Vtb_delta_sigma> wave;
+    if (trace) wave.open(argc, argv, *top, "logs/tb_delta_sigma_check.fst");
+
+    top->clk_i         = 0;
+    top->rst_ni        = 0;
+    top->audio_valid_i = 0;
+    top->audio_i       = 0;
+    for (int i = 0; i < 5; i++) tick(ctx, top);
+    top->rst_ni = 1;
+
+    DeltaSigmaModel model;
+    uint32_t lfsr = check_seed(check);
+
+    bool ok = true;
+    for (uint64_t cycle = 0; cycle < cycles && ok; cycle++) {
+        bool en    = top->en_o;
+        bool valid = (cycle % CYCLES_PER_SAMPLE == 0);
+        int16_t sample = 0;
+
+        if (valid) {
+            lfsr = lfsr * 1664525u + 1013904223u;
+            sample = (int16_t)((lfsr >> 16) & 0x3FFF) << 2 >> 2;
+            top->audio_i = sample & 0x3FFF;
+        }
+        top->audio_valid_i = valid;
+        tick(ctx, top, wave);
+        wave.step(cycle);
+
+        // Both registers update on the same edge: y still sees the old sample
+        if (en)    model.step();
+        if (valid) model.set_input(sample);
+
+        if (top->wave_o != model.ds) {
+            std::fprintf(stderr, "[TB] Model mismatch at cycle %llu: RTL %d, model %d\n",
+                         (unsigned long long)cycle, top->wave_o, model.ds);
+            wave.trigger(cycle, TRIG_MISMATCH, "model mismatch");
+            wave.close();
+            ok = false;
+        }
+    }
+
+    top->final();
+    return ok;
+}
+
+/**
+ * @brief Period of the modulator state from its current point (Brent).
+ *
+ * @return  Cycle length in modulator clocks, or 0 if above max_steps.
+ */
+uint64_t find_period(const DeltaSigmaModel& start, uint64_t max_steps) {
+    DeltaSigmaModel tortoise = start;
+    DeltaSigmaModel hare     = start;
+    hare.step();
+
+    uint64_t power = 1, lambda = 1;
+    for (uint64_t n = 0; n < max_steps; n++) {
+        if (hare.e1 == tortoise.e1 && hare.e2 == tortoise.e2) return lambda;
+        if (power == lambda) {
+            tortoise = hare;
+            power <<= 1;
+            lambda = 0;
+        }
+        hare.step();
+        lambda++;
+    }
+    return 0;
+}
+
+DcResult analyze_dc(int code, size_t n, const std::vector<double>& window, double tone_dbfs) {
+    DeltaSigmaModel m;
+    m.set_input(code);
+    for (uint64_t i = 0; i < DC_SETTLE_STEPS; i++) m.step();
+
+    DcResult r;
+    r.code   = code;
+    r.period = find_period(m, DC_MAX_PERIOD);
+
+    std::vector<double> pdm(n);
+    double sum = 0.0;
+    for (auto& x : pdm) {
+        x = m.step() ? 1.0 : -1.0;
+        sum += x;
+    }
+    r.dc_err = sum / n * FULL_SCALE - code;
+
+    std::vector<double> p = power_spectrum(pdm, window);
+    double bin_hz = (double)DAC_RATE_HZ / n;
+    size_t band_k = (size_t)(AUDIO_BAND_HZ / bin_hz);
+
+    size_t k_spur = LOBE_BINS + 1;
+    for (size_t k = LOBE_BINS + 1; k <= band_k; k++) if (p[k] > p[k_spur]) k_spur = k;
+
+    double inband = 0.0;
+    for (size_t k = LOBE_BINS + 1; k <= band_k; k++) inband += p[k];
+
+    double lobe = 0.0;
+    for (size_t k = k_spur - LOBE_BINS; k <= std::min(k_spur + LOBE_BINS, band_k); k++) lobe += p[k];
+
+    // A constant input gives a line spectrum, so spurs are judged by absolute level
+    r.spur_hz     = k_spur * bin_hz;
+    r.spur_dbfs   = 10.0 * std::log10(2.0 * lobe + 1e-30);
+    r.inband_dbfs = 10.0 * std::log10(inband + 1e-30);
+    r.overload    = std::fabs(r.dc_err) > DC_OVERLOAD_CODES;
+    r.problem     = !r.overload && r.spur_dbfs > tone_dbfs;
+    return r;
+}
+
+int run_dc_sweep(int argc, char** argv) {
+    unsigned threads   = sim_threads(argc, argv);
+    int      fft_order = get_plusarg_int(argc, argv, "fft_order", 17);
+    int      step      = std::max(1L, get_plusarg_int(argc, argv, "code_step", 1));
+    double   tone_dbfs = get_plusarg_int(argc, argv, "tone_dbfs", -80);
+    size_t   n         = (size_t)1 << fft_order;
+
+    std::vector<int> codes;
+    for (int c = -8192; c <= 8191; c += step) codes.push_back(c);
+
+    std::cout << "[TB] Delta-Sigma DC Sweep (" << codes.size() << " codes, "
+              << n << "-point FFT, " << threads << " threads)" << std::endl;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    // A traced check runs alone, the checks would share the dump file
+    const unsigned num_checks = has_plusarg(argc, argv, "trace_on") ? 1 : std::max(4u, threads);
+    if (!check_model_parallel(num_checks, threads, [&](size_t i) {
+            return check_delta_sigma_model(argc, argv, 100 * CYCLES_PER_SAMPLE, i);
+        })) return 1;
+    std::cout << "[TB] Model matches RTL" << std::endl;
+
+    const size_t CODES_PER_JOB = 64;
+    const std::vector<double> window = blackman_harris(n);
+    std::vector<DcResult> results(codes.size());
+    parallel_for((codes.size() + CODES_PER_JOB - 1) / CODES_PER_JOB, threads, [&](size_t job, unsigned) {
+        size_t end = std::min(codes.size(), (job + 1) * CODES_PER_JOB);
+        for (size_t i = job * CODES_PER_JOB; i < end; i++) {
+            results[i] = analyze_dc(codes[i], n, window, tone_dbfs);
+        }
+    });
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::ofstream csv("tmp/delta_sigma_dc.csv");
+    if (!csv.is_open()) {
+        std::cerr << "[TB] Error: Could not open " << "tmp/delta_sigma_dc.csv" << std::endl;
+        return 1;
+    }
+    csv << "code,dc_err,period,spur_hz,spur_dbfs,inband_dbfs,overload,problem\n";
+    size_t problems = 0, overloads = 0, inband_cycles = 0;
+    for (const auto& r : results) {
+        csv << r.code << "," << r.dc_err << "," << r.period << "," << r.spur_hz << ","
+            << r.spur_dbfs << "," << r.inband_dbfs << "," << r.overload << ","
+            << r.problem << "\n";
+        problems  += r.problem;
+        overloads += r.overload;
+        if (!r.overload && r.period && (double)DAC_RATE_HZ / r.period <= AUDIO_BAND_HZ) inband_cycles++;
+    }
+    csv.close();
+
+    // Group adjacent problem codes into ranges
+    std::printf("\n[TB] Idle-tone code ranges (in-band spur > %.0f dBFS):\n", tone_dbfs);
+    int shown = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        if (!results[i].problem) continue;
+        size_t j = i;
+        const DcResult* worst = &results[i];
+        while (j + 1 < results.size() && results[j + 1].problem) {
+            j++;
+            if (results[j].spur_dbfs > worst->spur_dbfs) worst = &results[j];
+        }
+        if (shown++ < 40) {
+            std::printf("[TB]   %6d .. %6d  worst %6d: %7.0f Hz %7.1f dBFS, period %llu\n",
+                        results[i].code, results[j].code, worst->code, worst->spur_hz,
+                        worst->spur_dbfs, (unsigned long long)worst->period);
+        }
+        i = j;
+    }
+    if (shown > 40) std::printf("[TB]   ... %d more ranges\n", shown - 40);
+
+    std::printf("\n[TB] Idle-tone codes:       %zu / %zu (%.1f %%)\n",
+                problems, results.size(), 100.0 * problems / results.size());
+    std::printf("[TB] Overloaded codes:      %zu (DC error > %.0f codes)\n", overloads, DC_OVERLOAD_CODES);
+    std::printf("[TB] In-band limit cycles:  %zu codes (period >= %.0f clocks)\n",
+                inband_cycles, DAC_RATE_HZ / AUDIO_BAND_HZ);
+
+    std::cout << "\n[TB] Finished in " << elapsed << " s" << std::endl;
+    std::cout << "[TB] Saved to tmp/delta_sigma_dc.csv" << std::endl;
+    return 0;
+}
+
 int main(int argc, char** argv) {
+    if (has_plusarg(argc, argv, "analyze"))  return run_analyze(argc, argv);
+    if (has_plusarg(argc, argv, "dc_sweep")) return run_dc_sweep(argc, argv);
+
     Verilated::mkdir("logs");
     const std::unique_ptr<VerilatedContext> contextp{new VerilatedContext};
     contextp->commandArgs(argc, argv);
-    contextp->traceEverOn(false);
+    contextp->traceEverOn(has_plusarg(argc, argv, "trace"));
     const std::unique_ptr<Vtb_delta_sigma> top{new Vtb_delta_sigma{contextp.get(), "TOP"}};
 
     PdmCapture pdm;
@@ -68,5 +534,6 @@ int main(int argc, char** argv) {
     top->final();
 
     std::cout << "[TB] Captured " << pdm.total << " PDM samples" << std::endl;
+    report_stats(argc, argv, contextp, "delta_sigma");
     return 0;
 }
@@ -0,0 +1,188 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  File: sim_dsp.h
+//  Description: Signal analysis utilities for the TT6581 testbenches.
+//
+//  Author:
+//    - Andreas Pedersen
+//
+//-------------------------------------------------------------------------------------------------
+
+#ifndef SIM_DSP_H
+#define SIM_DSP_H
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//=============================================================================
+// FFT
+//=============================================================================
+
+/**
+ * @brief In-place iterative radix-2 FFT.
+ *
+ * @param x  Complex samples. Length must be a power of two.
+ */
+inline void fft(std::vector<std::complex<double>>& x) {
+    size_t n = x.size();
+
+    // Bit-reversal permutation
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(x[i], x[j]);
+    }
+
+    for (size_t len = 2; len <= n; len <<= 1) {
+        std::complex<double> w_len = std::polar(1.0, -2.0 * M_PI / len);
+        for (size_t i = 0; i < n; i += len) {
+            std::complex<double> w = 1.0;
+            for (size_t k = 0; k < len / 2; k++) {
+                std::complex<double> u = x[i + k];
+                std::complex<double> v = x[i + k + len / 2] * w;
+                x[i + k]           = u + v;
+                x[i + k + len / 2] = u - v;
+                w *= w_len;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Smallest power of two >= n.
+ */
+inline size_t next_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+//=============================================================================
+// Spectral Analysis
+//=============================================================================
+
+/**
+ * @brief 4-term Blackman-Harris window (-92 dB sidelobes).
+ *
+ * The main lobe spans +/-4 bins.
+ */
+inline std::vector<double> blackman_harris(size_t n) {
+    std::vector<double> w(n);
+    for (size_t i = 0; i < n; i++) {
+        double x = 2.0 * M_PI * i / n;
+        w[i] = 0.35875 - 0.48829 * std::cos(x) + 0.14128 * std::cos(2 * x) - 0.01168 * std::cos(3 * x);
+    }
+    return w;
+}
+
+/**
+ * @brief One-sided windowed power spectrum.
+ *
+ * Normalized so the bins sum to the mean square of the input, i.e. a sine
+ * of amplitude A contributes A^2/2 spread over its main lobe.
+ *
+ * @param x  Samples. Length must be a power of two.
+ * @param w  Window of the same length.
+ * @return   Power per bin, n/2 + 1 bins from DC to Nyquist.
+ */
+inline std::vector<double> power_spectrum(const std::vector<double>& x, const std::vector<double>& w) {
+    size_t n = x.size();
+    std::vector<std::complex<double>> buf(n);
+    double w_pow = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = x[i] * w[i];
+        w_pow += w[i] * w[i];
+    }
+    fft(buf);
+
+    std::vector<double> p(n / 2 + 1);
+    for (size_t k = 0; k <= n / 2; k++) {
+        double scale = (k == 0 || k == n / 2) ? 1.0 : 2.0;
+        p[k] = scale * std::norm(buf[k]) / (n * w_pow);
+    }
+    return p;
+}
+
+//=============================================================================
+// Excitation Signals
+//=============================================================================
+
+/**
+ * @brief Generate one period of a maximum-length sequence (MLS).
+ *
+ * Fibonacci LFSR with maximal-length feedback taps. The sequence has
+ * length 2^order - 1 and values +1/-1.
+ *
+ * @param order  LFSR length (10..18).
+ * @return       MLS of length 2^order - 1, or empty for unsupported orders.
+ */
+inline std::vector<int8_t> mls_sequence(int order) {
+    static const uint32_t TAPS[] = {
+        0x240, 0x500, 0xE08, 0x1C80, 0x3802, 0x6000, 0xD008, 0x12000, 0x20400
+    };
+    if (order < 10 || order > 18) return {};
+
+    uint32_t taps  = TAPS[order - 10];
+    uint32_t mask  = (1u << order) - 1;
+    uint32_t state = 1;
+
+    std::vector<int8_t> seq(mask);
+    for (auto& s : seq) {
+        uint32_t bit = __builtin_parity(state & taps);
+        state = ((state << 1) | bit) & mask;
+        s = (state & 1) ? 1 : -1;
+    }
+    return seq;
+}
+
+/**
+ * @brief Recover an impulse response from an MLS measurement.
+ *
+ * Circular cross-correlation of one steady-state output period with the
+ * excitation, corrected for the -1 off-peak autocorrelation of the MLS.
+ * The correlation runs through the FFT, O(L log L): the output is
+ * correlated with two periods of the excitation, zero-padded to a power
+ * of two of at least 2L so the linear correlation does not wrap.
+ *
+ * @param seq  MLS excitation (+1/-1), length L.
+ * @param y    System output over one period, length L.
+ * @param amp  Excitation amplitude (input = amp * seq).
+ * @return     Impulse response of length L.
+ */
+inline std::vector<double> mls_impulse_response(const std::vector<int8_t>& seq,
+                                                const std::vector<double>& y,
+                                                double amp) {
+    size_t L = seq.size();
+    size_t N = next_pow2(2 * L);
+
+    // r[j] = sum_n y[n] * seq[(n + j) % L], so raw[k] = r[L - k]
+    std::vector<std::complex<double>> Y(N), S(N);
+    for (size_t n = 0; n < L; n++) Y[n] = y[n];
+    for (size_t n = 0; n < 2 * L; n++) S[n] = seq[n % L];
+    fft(Y);
+    fft(S);
+
+    // Inverse FFT of conj(Y) * S as the conjugate of a forward FFT
+    for (size_t k = 0; k < N; k++) S[k] = Y[k] * std::conj(S[k]);
+    fft(S);
+
+    std::vector<double> raw(L);
+    for (size_t k = 0; k < L; k++) raw[k] = S[L - k].real() / N / amp;
+
+    double h0 = 0.0;
+    for (double r : raw) h0 += r;
+
+    std::vector<double> h(L);
+    for (size_t k = 0; k < L; k++) h[k] = (raw[k] + h0) / (L + 1);
+    return h;
+}
+
+#endif // SIM_DSP_H
@@ -3,6 +3,10 @@
 //  File: sim_envelope.cpp
 //  Description: Verilator testbench for 8-bit envelope generator.
 //               Inputs maximum amplitude and applies envelope.
+//               Runs sample-driven by default: the idle clocks between
+//               samples are skipped, logged times still follow the real
+//               50 kHz timeline. +full_clock ticks every cycle.
+//               With +adsr_table, characterizes every A/D/S/R setting.
 //
 //  Author:
 //    - Andreas Pedersen
@@ -10,19 +14,248 @@
 //-------------------------------------------------------------------------------------------------
 
 #include "sim_common.h"
+#include "sim_model.h"
 #include "Vtb_envelope.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
 const uint64_t MAX_CYCLES = 100000000;
 
+//=============================================================================
+// ADSR characterization (+adsr_table)
+//=============================================================================
+
+// MOS6581 datasheet rates (ms): attack, and decay/release from peak to zero
+const double MOS6581_ATTACK_MS[16] = {
+    2, 8, 16, 24, 38, 56, 68, 80, 100, 250, 500, 800, 1000, 3000, 5000, 8000
+};
+const double MOS6581_DECAY_MS[16] = {
+    6, 24, 48, 72, 114, 168, 204, 240, 300, 750, 1500, 2400, 3000, 9000, 15000, 24000
+};
+
+const uint64_t MAX_ENV_SAMPLES = 100 * SAMPLE_RATE_HZ;    // Give up after 100 s
+
+inline double samples_to_ms(int64_t n) {
+    return n < 0 ? NAN : 1000.0 * n / SAMPLE_RATE_HZ;
+}
+
+// Process one voice slot: start_i until ready_o, then back to idle
+void run_voice(const std::unique_ptr<VerilatedContext>& ctx,
+               const std::unique_ptr<Vtb_envelope>& top, int voice) {
+    top->voice_idx_i = voice;
+    top->start_i = 1;
+    tick(ctx, top);
+    top->start_i = 0;
+
+    int cycles = 0;
+    while (!top->ready_o && cycles < 100) {
+        tick(ctx, top);
+        cycles++;
+    }
+}
+
+/**
+ * @brief Check the envelope model against the RTL on all three voice slots.
+ *
+ * Each slot gets its own random ADSR settings and gate pattern. Volume and
+ * ADSR state are compared after every voice update.
+ */
+bool check_envelope_model(uint32_t seed, uint64_t num_samples) {
+    const std::unique_ptr<VerilatedContext> ctx{new VerilatedContext};
+    ctx->traceEverOn(false);
+    const std::unique_ptr<Vtb_envelope> top{new Vtb_envelope{ctx.get(), "TOP"}};
+
+    top->clk_i   = 0;
+    top->rst_ni  = 0;
+    top->start_i = 0;
+    top->voice_i = 1;
+    for (int i = 0; i < 5; i++) tick(ctx, top);
+    top->rst_ni = 1;
+    for (int i = 0; i < 5; i++) tick(ctx, top);
+
+    EnvelopeModel model;
+    uint32_t lfsr = seed;
+    auto rnd = [&]() { lfsr = lfsr * 1664525u + 1013904223u; return lfsr >> 16; };
+
+    int  adsr[3][4] = {};
+    bool gate[3]    = {};
+
+    for (uint64_t n = 0; n < num_samples; n++) {
+        for (int v = 0; v < 3; v++) {
+            // Mostly fast rates so every state is visited many times
+            if (rnd() % 2000 == 0) {
+                for (int k = 0; k < 4; k++) adsr[v][k] = (rnd() % 4) ? rnd() % 10 : rnd() % 16;
+            }
+            if (rnd() % 500 == 0) gate[v] = !gate[v];
+
+            top->gate_i    = gate[v];
+            top->attack_i  = adsr[v][0];
+            top->decay_i   = adsr[v][1];
+            top->sustain_i = adsr[v][2];
+            top->release_i = adsr[v][3];
+            run_voice(ctx, top, v);
+            model.step(v, gate[v], adsr[v][0], adsr[v][1], adsr[v][2], adsr[v][3]);
+
+            if (top->env_vol_o != model.vol[v] || top->env_state_o != model.state[v]) {
+                std::fprintf(stderr, "[TB] Model mismatch: seed %u sample %llu voice %d: "
+                             "RTL vol %06X state %d, model vol %06X state %d\n",
+                             seed, (unsigned long long)n, v, top->env_vol_o, top->env_state_o,
+                             model.vol[v], model.state[v]);
+                return false;
+            }
+            tick(ctx, top);
+        }
+    }
+
+    top->final();
+    return true;
+}
+
+struct EnvelopeTiming {
+    int64_t samples = -1;           // Samples until the measured event
+    int64_t shift_at[3] = {-1, -1, -1};  // Samples until exp_shift becomes 1, 2, 3
+};
+
+// Attack from zero until the voice leaves STATE_ATTACK (cur_vol >= MAX_VOL)
+EnvelopeTiming measure_attack(int attack) {
+    EnvelopeModel m;
+    EnvelopeTiming t;
+    for (uint64_t n = 0; n < MAX_ENV_SAMPLES; n++) {
+        m.step(0, true, attack, 0, 15, 0);
+        if (m.state[0] == EnvelopeModel::DECAY) {
+            t.samples = n;
+            break;
+        }
+    }
+    return t;
+}
+
+// Decay from the attack peak until STATE_SUSTAIN, or release from full scale to zero
+EnvelopeTiming measure_fall(int rate, int sustain, bool release) {
+    EnvelopeModel m;
+    EnvelopeTiming t;
+
+    // Instant attack to the peak
+    while (m.state[0] != EnvelopeModel::DECAY) m.step(0, true, 0, rate, release ? 15 : sustain, rate);
+
+    if (release) {
+        // Settle at full sustain, then gate off
+        while (m.state[0] != EnvelopeModel::SUSTAIN) m.step(0, true, 0, 0, 15, rate);
+        m.vol[0] = EnvelopeModel::MAX_VOL;
+    }
+
+    for (uint64_t n = 0; n < MAX_ENV_SAMPLES; n++) {
+        int shift = EnvelopeModel::exp_shift(m.vol[0]);
+        m.step(0, !release, 0, rate, sustain, rate);
+
+        int new_shift = EnvelopeModel::exp_shift(m.vol[0]);
+        for (int k = shift; k < new_shift; k++) {
+            if (t.shift_at[k] < 0) t.shift_at[k] = n + 1;
+        }
+
+        bool done = release ? (m.vol[0] == 0) : (m.state[0] == EnvelopeModel::SUSTAIN);
+        if (done) {
+            t.samples = n + 1;
+            break;
+        }
+    }
+    return t;
+}
+
+int run_adsr_table(int argc, char** argv) {
+    unsigned threads = sim_threads(argc, argv);
+    uint64_t check_samples = get_plusarg_int(argc, argv, "check_samples", 20000);
+
+    std::cout << "[TB] ADSR Characterization (" << threads << " threads)" << std::endl;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    // Verify the model on the RTL first, one model instance per thread
+    const unsigned NUM_CHECKS = std::max(4u, threads);
+    if (!check_model_parallel(NUM_CHECKS, threads, [&](size_t i) {
+            return check_envelope_model(check_seed(i), check_samples);
+        })) return 1;
+    std::cout << "[TB] Model matches RTL on all 3 voice slots ("
+              << NUM_CHECKS * check_samples << " samples)" << std::endl;
+
+    // Jobs: 16 attack, 16x16 decay/sustain, 16 release
+    std::vector<EnvelopeTiming> attack(16), release(16), decay(256);
+    parallel_for(16 + 256 + 16, threads, [&](size_t i, unsigned) {
+        if (i < 16)            attack[i]       = measure_attack(i);
+        else if (i < 16 + 256) decay[i - 16]   = measure_fall((i - 16) / 16, (i - 16) % 16, false);
+        else                   release[i - 272] = measure_fall(i - 272, 0, true);
+    });
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::ofstream ar("tmp/adsr_attack_release.csv");
+    if (!ar.is_open()) {
+        std::cerr << "[TB] Error: Could not open " << "tmp/adsr_attack_release.csv" << std::endl;
+        return 1;
+    }
+    ar << "rate,attack_step,attack_ms,mos6581_attack_ms,decay_step,release_ms,mos6581_decay_ms,"
+          "release_shift1_ms,release_shift2_ms,release_shift3_ms\n";
+    for (int r = 0; r < 16; r++) {
+        ar << r << "," << EnvelopeModel::ATTACK_LUT[r] << ","
+           << samples_to_ms(attack[r].samples) << "," << MOS6581_ATTACK_MS[r] << ","
+           << EnvelopeModel::DECAY_LUT[r] << ","
+           << samples_to_ms(release[r].samples) << "," << MOS6581_DECAY_MS[r];
+        for (int k = 0; k < 3; k++) ar << "," << samples_to_ms(release[r].shift_at[k]);
+        ar << "\n";
+    }
+    ar.close();
+
+    std::ofstream dc("tmp/adsr_decay.csv");
+    if (!dc.is_open()) {
+        std::cerr << "[TB] Error: Could not open " << "tmp/adsr_decay.csv" << std::endl;
+        return 1;
+    }
+    dc << "decay,sustain,decay_ms,shift1_ms,shift2_ms,shift3_ms\n";
+    for (int d = 0; d < 16; d++) {
+        for (int s = 0; s < 16; s++) {
+            const auto& t = decay[d * 16 + s];
+            dc << d << "," << s << "," << samples_to_ms(t.samples);
+            for (int k = 0; k < 3; k++) dc << "," << samples_to_ms(t.shift_at[k]);
+            dc << "\n";
+        }
+    }
+    dc.close();
+
+    std::printf("\n[TB] rate   attack ms  (6581)  err%%    decay ms*  release ms  (6581)  err%%\n");
+    for (int r = 0; r < 16; r++) {
+        double a_ms = samples_to_ms(attack[r].samples);
+        double d_ms = samples_to_ms(decay[r * 16].samples);
+        double r_ms = samples_to_ms(release[r].samples);
+        std::printf("[TB] %4X %11.1f %7.0f %6.1f %11.1f %11.1f %7.0f %6.1f\n", r,
+                    a_ms, MOS6581_ATTACK_MS[r], 100.0 * (a_ms / MOS6581_ATTACK_MS[r] - 1.0),
+                    d_ms, r_ms, MOS6581_DECAY_MS[r], 100.0 * (r_ms / MOS6581_DECAY_MS[r] - 1.0));
+    }
+    std::cout << "[TB] * decay from peak to sustain 0" << std::endl;
+    std::cout << "\n[TB] Finished in " << elapsed << " s" << std::endl;
+    std::cout << "[TB] Saved to tmp/adsr_attack_release.csv and tmp/adsr_decay.csv" << std::endl;
+    return 0;
+}
+
 int main(int argc, char** argv) {
     Verilated::mkdir("logs");
     const std::unique_ptr<VerilatedContext> contextp{new VerilatedContext};
     contextp->commandArgs(argc, argv);
-    contextp->traceEverOn(false);
+    contextp->traceEverOn(has_plusarg(argc, argv, "trace"));
     const std::unique_ptr<Vtb_envelope> top{new Vtb_envelope{contextp.get(), "TOP"}};
 
-    std::ofstream csv_file("tmp/envelope_output.csv");
-    csv_file << "time_sec,voice_idx,gate,value\n";
+    if (has_plusarg(argc, argv, "adsr_table")) {
+        top->final();
+        return run_adsr_table(argc, argv);
+    }
+
+    TableWriter<double, uint8_t, uint8_t, int64_t> out_file;
+    if (!out_file.open("tmp/envelope_output", {"time_sec", "voice_idx", "gate", "value"},
+                       has_plusarg(argc, argv, "csv"))) {
+        std::cerr << "[TB] Error: Could not open " << out_file.filename() << std::endl;
+        return 1;
+    }
 
     // Initial pin state
     top->clk_i       = 0;
@@ -38,7 +271,10 @@ int main(int argc, char** argv) {
     top->sustain_i = 0xA;   // 0xAA/0xFF = ~0.66
     top->release_i = 0x9;   // 750 ms
 
+    const bool full_clock = has_plusarg(argc, argv, "full_clock");
+
     std::cout << "[TB] Envelope Generator Testbench" << std::endl;
+    std::cout << "[TB] Timebase: " << (full_clock ? "full clock" : "sample-driven") << std::endl;
 
     // Reset
     for (int i = 0; i < 5; i++) tick(contextp, top);
@@ -46,11 +282,23 @@ int main(int argc, char** argv) {
     for (int i = 0; i < 5; i++) tick(contextp, top);
 
     uint64_t cycle_count  = 0;
+    uint64_t eval_count   = 0;
     uint64_t sample_timer = 0;
     int current_voice = 0;
     int tdm_phase     = 0;
 
     while (cycle_count < MAX_CYCLES) {
+        // Envelope and multiplier are idle until the next sample: jump to
+        // the cycle that starts it instead of ticking through
+        if (!full_clock && tdm_phase == 0 && sample_timer + 1 < CYCLES_PER_SAMPLE) {
+            uint64_t idle = std::min<uint64_t>(CYCLES_PER_SAMPLE - 1 - sample_timer,
+                                               MAX_CYCLES - cycle_count);
+            skip_ticks(contextp, idle);
+            cycle_count  += idle;
+            sample_timer += idle;
+            if (cycle_count >= MAX_CYCLES) break;
+        }
+
         double time_now = cycle_count * 20e-9;
 
         // Apply gate
@@ -82,10 +330,7 @@ int main(int argc, char** argv) {
                 if (top->ready_o) {
                     if (current_voice == 0) {
                         int64_t prod = (int64_t)top->prod_o;
-                        csv_file << time_now << ","
-                                 << current_voice << ","
-                                 << (int)top->gate_i << ","
-                                 << prod << "\n";
+                        out_file.row(time_now, current_voice, top->gate_i, prod);
                     }
 
                     current_voice++;
@@ -100,12 +345,15 @@ int main(int argc, char** argv) {
 
         tick(contextp, top);
         cycle_count++;
+        eval_count++;
     }
 
-    csv_file.close();
+    out_file.close();
     top->final();
 
     std::cout << "[TB] Simulation finished. Time simulated: "
               << cycle_count * 20e-9 << "s" << std::endl;
+    std::cout << "[TB] Cycles evaluated: " << eval_count << " / " << cycle_count << std::endl;
+    report_stats(argc, argv, contextp, "envelope");
     return 0;
 }
@@ -0,0 +1,330 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  File: sim_model.h
+//  Description: Bit-exact C++ reference models of TT6581 datapath blocks.
+//               Used for fast sweeps that would take too long through Verilator.
+//
+//  Author:
+//    - Andreas Pedersen
+//
+//-------------------------------------------------------------------------------------------------
+
+#ifndef SIM_MODEL_H
+#define SIM_MODEL_H
+
+#include <cstdint>
+
+//=============================================================================
+// Fixed-Point Helpers
+//=============================================================================
+
+/**
+ * @brief Wrap a value to an N-bit two's complement signed integer.
+ *
+ * @tparam BITS  Register width.
+ * @param v      Value to wrap.
+ * @return       v truncated to BITS bits and sign-extended.
+ */
+template <int BITS>
+inline int32_t wrap_signed(int64_t v) {
+    return (int32_t)((int64_t)((uint64_t)v << (64 - BITS)) >> (64 - BITS));
+}
+
+/**
+ * @brief Shared 24x16 signed multiplier (mult.sv).
+ *
+ * The shift-add datapath works on magnitudes and is exact over the full
+ * operand range, including -2^23 and -2^15.
+ */
+inline int64_t mult_model(int32_t a, int16_t b) {
+    return (int64_t)wrap_signed<24>(a) * (int64_t)b;
+}
+
+//=============================================================================
+// Voice Oscillator (multi_voice.sv)
+//=============================================================================
+
+/**
+ * @brief Bit-exact model of one multi_voice voice slot.
+ *
+ * write() corresponds to the slot's STATE_WRITE: the 19-bit phase advances
+ * by the FCW once per sample and the noise LFSR clocks on a rising edge of
+ * phase bit 9. wave() is the combinational wave_o for the current state,
+ * i.e. what the controller multiplies after ready_o. Sync and ring
+ * modulation read the previous voice's slot (voice 2 for voice 0).
+ */
+struct OscillatorModel {
+    static constexpr uint32_t PHASE_MASK = (1u << 19) - 1;
+
+    uint32_t phase    = 0;          // phase_regs, 19 bits
+    uint32_t lfsr     = 0x7FFFFF;   // lfsr_regs, 23 bits
+    uint8_t  last_msb = 0;          // phase_last_msb, last two phase MSBs
+
+    // Waveforms of a phase value (wave_sel_i one-hot: tri, saw, pulse, noise)
+    static int16_t saw(uint32_t p) {
+        return (int16_t)wrap_signed<10>(p >> 9);
+    }
+
+    static int16_t tri(uint32_t p, bool fold) {
+        uint32_t v = (p >> 8) & 0x3FF;
+        if (fold) v = ~v & 0x3FF;
+        return (int16_t)wrap_signed<10>(v ^ 0x200);
+    }
+
+    static int16_t pulse(uint32_t p, uint16_t pw) {
+        return ((p >> 7) >= (pw & 0xFFFu)) ? 511 : -512;
+    }
+
+    int16_t noise() const {
+        static constexpr int TAPS[8] = {20, 18, 14, 11, 9, 5, 2, 0};
+        uint32_t v = 0;
+        for (int t : TAPS) v = (v << 1) | ((lfsr >> t) & 1);
+        return (int16_t)wrap_signed<10>((v ^ 0x80) << 2);
+    }
+
+    /**
+     * @brief Next phase (nxt_phase), including a hard sync reset.
+     */
+    uint32_t next_phase(uint16_t fcw, bool sync, const OscillatorModel& prev) const {
+        if (sync && prev.last_msb == 0b01) return 0;
+        return (phase + fcw) & PHASE_MASK;
+    }
+
+    /**
+     * @brief Combinational wave_o for the current state.
+     */
+    int16_t wave(uint16_t fcw, uint16_t pw, int wave_sel, bool sync, bool ring_mod,
+                 const OscillatorModel& prev) const {
+        uint32_t nxt  = next_phase(fcw, sync, prev);
+        bool     fold = (nxt >> 18) & 1;
+        if (ring_mod) fold ^= (prev.phase >> 18) & 1;
+
+        switch (wave_sel) {
+            case 0b0001: return tri(nxt, fold);
+            case 0b0010: return saw(nxt);
+            case 0b0100: return pulse(nxt, pw);
+            case 0b1000: return noise();
+            default:     return 0;
+        }
+    }
+
+    /**
+     * @brief Register update of one voice slot (STATE_WRITE).
+     */
+    void write(uint16_t fcw, bool sync, const OscillatorModel& prev) {
+        uint32_t nxt = next_phase(fcw, sync, prev);
+        if (!((phase >> 9) & 1) && ((nxt >> 9) & 1)) {
+            lfsr = ((lfsr << 1) | (((lfsr >> 22) ^ (lfsr >> 17)) & 1)) & 0x7FFFFF;
+        }
+        last_msb = ((last_msb << 1) | (nxt >> 18)) & 0b11;
+        phase    = nxt;
+    }
+};
+
+//=============================================================================
+// Chamberlin State-Variable Filter (svf.sv)
+//=============================================================================
+
+/**
+ * @brief Bit-exact model of one SVF sample computation.
+ *
+ * Mirrors the STATE_CALC_HP / STATE_CALC_BP / STATE_CALC_LP sequence of
+ * svf.sv, including the 24-bit state registers and the product slices
+ * taken from the shared multiplier.
+ */
+struct SvfModel {
+    int32_t reg_band = 0;   // 24-bit band-pass state
+    int32_t reg_low  = 0;   // 24-bit low-pass state
+    int32_t hp_node  = 0;   // 24-bit high-pass node
+    bool    wrapped  = false;   // Set if any state update overflowed 24 bits
+
+    void reset() {
+        reg_band = 0;
+        reg_low  = 0;
+        hp_node  = 0;
+        wrapped  = false;
+    }
+
+    /**
+     * @brief Compute one sample.
+     *
+     * @param wave_i     14-bit signed filter input.
+     * @param coeff_f    Q1.15 frequency coefficient.
+     * @param coeff_q    Q4.12 damping coefficient.
+     */
+    void step(int16_t wave_i, int16_t coeff_f, int16_t coeff_q) {
+        int64_t q_prod = mult_model(reg_band, coeff_q);
+        int32_t q_sh   = wrap_signed<24>(q_prod >> 12);    // mult_prod_i[35:12]
+        int64_t hp     = (int64_t)wrap_signed<14>(wave_i) - reg_low - q_sh;
+        hp_node = wrap_signed<24>(hp);
+        wrapped |= (hp != hp_node);
+
+        int64_t f1_prod = mult_model(hp_node, coeff_f);
+        int64_t band    = (int64_t)reg_band + wrap_signed<24>(f1_prod >> 15);  // [38:15]
+        reg_band = wrap_signed<24>(band);
+        wrapped |= (band != reg_band);
+
+        int64_t f2_prod = mult_model(reg_band, coeff_f);
+        int64_t low     = (int64_t)reg_low + wrap_signed<24>(f2_prod >> 15);
+        reg_low = wrap_signed<24>(low);
+        wrapped |= (low != reg_low);
+    }
+
+    /**
+     * @brief Unsaturated output for a filt_sel_i value (selected_out).
+     */
+    int32_t selected(int filt_sel) const {
+        switch (filt_sel) {
+            case 0b001: return reg_low;
+            case 0b010: return reg_band;
+            case 0b100: return hp_node;
+            case 0b101: return wrap_signed<24>((int64_t)hp_node + reg_low);
+            default:    return reg_low;
+        }
+    }
+
+    /**
+     * @brief Saturated 14-bit output (wave_o).
+     */
+    int16_t output(int filt_sel) const {
+        int32_t v = selected(filt_sel);
+        if (v > 8191)  return 8191;
+        if (v < -8192) return -8192;
+        return (int16_t)v;
+    }
+};
+
+//=============================================================================
+// ADSR Envelope Generator (envelope.sv)
+//=============================================================================
+
+/**
+ * @brief Bit-exact model of the three-voice envelope generator.
+ *
+ * One call to step() corresponds to one STATE_ADSR cycle for a voice,
+ * i.e. one start_i/ready_o handshake. 24-bit wraparound in the sustain
+ * comparison is reproduced as in the RTL.
+ */
+struct EnvelopeModel {
+    enum State { ATTACK = 0, DECAY = 1, SUSTAIN = 2, RELEASE = 3 };
+
+    static constexpr uint32_t MAX_VOL = 0xFFFFFF;
+
+    static constexpr uint32_t ATTACK_LUT[16] = {
+        167116, 41779, 20889, 13926, 8795, 5968, 4915, 4177,
+        3342,   1336,  668,   417,   334,  111,  66,   41
+    };
+
+    static constexpr uint32_t DECAY_LUT[16] = {
+        139262, 34815, 17407, 11605, 7327, 4972, 4095, 3480,
+        2785,   1112,  555,   347,   277,  92,   55,   32
+    };
+
+    uint32_t vol[3]   = {0, 0, 0};                  // Q8.16 volume per voice
+    State    state[3] = {RELEASE, RELEASE, RELEASE};
+
+    /**
+     * @brief Exponential decay shift for a volume (exp_shift).
+     */
+    static int exp_shift(uint32_t v) {
+        if (v & 0x800000) return 0;
+        if (v & 0x400000) return 1;
+        if (v & 0x200000) return 2;
+        return 3;
+    }
+
+    /**
+     * @brief Process one voice for one sample.
+     *
+     * @return  env_raw_o seen by the multiplier (volume before the update).
+     */
+    uint8_t step(int voice, bool gate, int attack, int decay, int sustain, int release) {
+        uint32_t cur_vol     = vol[voice];
+        State    cur_state   = state[voice];
+        uint32_t sustain_vol = (uint32_t)((sustain << 4) | sustain) << 16;
+
+        State nxt_state = cur_state;
+        if (!gate && cur_state != RELEASE) {
+            nxt_state = RELEASE;
+        } else if (gate && cur_state == RELEASE) {
+            nxt_state = ATTACK;
+        } else if (cur_state == ATTACK) {
+            if (cur_vol >= MAX_VOL) nxt_state = DECAY;
+        } else if (cur_state == DECAY) {
+            if (cur_vol <= sustain_vol) nxt_state = SUSTAIN;
+        }
+
+        // decay_release follows the current state, not the next one
+        int      rate = (cur_state == DECAY) ? decay : release;
+        uint32_t step = (nxt_state == ATTACK) ? ATTACK_LUT[attack]
+                                              : (DECAY_LUT[rate] >> exp_shift(cur_vol)) | 1;
+
+        uint32_t nxt_vol = cur_vol;
+        switch (nxt_state) {
+            case ATTACK: {
+                uint32_t sum = (cur_vol + step) & MAX_VOL;
+                nxt_vol = (sum < cur_vol) ? MAX_VOL : sum;
+                break;
+            }
+            case DECAY:
+                nxt_vol = (cur_vol <= ((sustain_vol + step) & MAX_VOL)) ? sustain_vol : cur_vol - step;
+                break;
+            case SUSTAIN:
+                nxt_vol = sustain_vol;
+                break;
+            case RELEASE:
+                nxt_vol = (cur_vol <= step) ? 0 : cur_vol - step;
+                break;
+        }
+
+        vol[voice]   = nxt_vol;
+        state[voice] = nxt_state;
+        return (uint8_t)(cur_vol >> 16);
+    }
+};
+
+//=============================================================================
+// Error-Feedback Delta-Sigma Modulator (delta_sigma.sv)
+//=============================================================================
+
+/**
+ * @brief Bit-exact model of the second-order error-feedback modulator.
+ *
+ * One call to step() corresponds to one en pulse (10 MHz). The 19-bit
+ * datapath wraps like the RTL.
+ */
+struct DeltaSigmaModel {
+    int32_t audio = 0;      // 19-bit held input, {audio_i[13], audio_i, 4'b0}
+    int32_t e1    = 0;
+    int32_t e2    = 0;
+    bool    ds    = false;
+
+    void reset() {
+        audio = 0;
+        e1    = 0;
+        e2    = 0;
+        ds    = false;
+    }
+
+    /**
+     * @brief Load a 14-bit sample (audio_valid_i).
+     */
+    void set_input(int16_t audio_i) {
+        audio = wrap_signed<19>((int64_t)wrap_signed<14>(audio_i) * 16);
+    }
+
+    /**
+     * @brief Advance one modulator clock.
+     *
+     * @return  New PDM output bit.
+     */
+    bool step() {
+        int32_t y = wrap_signed<19>((int64_t)audio + 2 * (int64_t)e1 - e2);
+        e2 = e1;
+        ds = (y >= 0);
+        e1 = wrap_signed<19>(ds ? (int64_t)y - 32768 : (int64_t)y + 32768);
+        return ds;
+    }
+};
+
+#endif // SIM_MODEL_H
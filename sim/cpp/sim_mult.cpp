@@ -3,6 +3,7 @@
 //  File: sim_mult.cpp
 //  Description: Verilator testbench for 24x16 bit shift-add multiplier.
 //               Inputs N random values and verifies them against software results.
+//               With +verify, runs a seeded multithreaded corner/distribution sweep.
 //
 //  Author:
 //    - Andreas Pedersen
@@ -10,9 +11,15 @@
 //-------------------------------------------------------------------------------------------------
 
 #include "sim_common.h"
+#include "sim_model.h"
 #include "Vtb_mult.h"
 
 #include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <random>
 
 // Sign-extend a 24-bit value to int32
 int32_t sext24(uint32_t val) {
@@ -27,11 +34,212 @@ int32_t sext16(uint16_t val) {
 
 const int NUM_TESTS = 10000;
 
+//=============================================================================
+// Seeded Verification (+verify)
+//=============================================================================
+
+// Operand classes. Each is split into shards that run on any worker.
+enum OpClass { CLASS_CORNER, CLASS_VOICE_ENV, CLASS_BYPASS_VOL, CLASS_SVF, CLASS_RANDOM, NUM_CLASSES };
+
+const char* CLASS_NAME[NUM_CLASSES] = {
+    "corner", "voice*env", "bypass*vol", "svf", "random"
+};
+
+const int VOICE_ENV_A_PER_SHARD  = 16;      // 10-bit wave values per shard (x256 env)
+const int BYPASS_VOL_A_PER_SHARD = 64;      // 14-bit sum values per shard (x256 volume)
+const uint64_t RANDOM_PER_SHARD  = 4096;
+
+// One multiplier instance per worker thread
+struct MultWorker {
+    std::unique_ptr<VerilatedContext> ctx{new VerilatedContext};
+    std::unique_ptr<Vtb_mult> top;
+
+    uint64_t cycles     = 0;
+    uint32_t min_lat    = UINT32_MAX;
+    uint32_t max_lat    = 0;
+
+    MultWorker() {
+        ctx->traceEverOn(false);
+        top.reset(new Vtb_mult{ctx.get(), "TOP"});
+        top->clk_i   = 0;
+        top->rst_ni  = 0;
+        top->start_i = 0;
+        for (int i = 0; i < 5; i++) tick(ctx, top);
+        top->rst_ni = 1;
+        for (int i = 0; i < 5; i++) tick(ctx, top);
+    }
+
+    ~MultWorker() { top->final(); }
+
+    // Back-to-back multiply: start, wait for ready_o, one cycle back to STATE_READY
+    int64_t run(int32_t a, int16_t b) {
+        top->op_a_i  = a & 0xFFFFFF;
+        top->op_b_i  = (uint16_t)b;
+        top->start_i = 1;
+        tick(ctx, top);
+        top->start_i = 0;
+
+        uint32_t lat = 1;
+        while (!top->ready_o && lat < 40) {
+            tick(ctx, top);
+            lat++;
+        }
+        int64_t got = (int64_t)((uint64_t)top->prod_o << 24) >> 24;
+        tick(ctx, top);
+
+        cycles += lat + 1;
+        min_lat = std::min(min_lat, lat);
+        max_lat = std::max(max_lat, lat);
+        return got;
+    }
+};
+
+// Sign/corner operands: extremes, walking ones, low-bit masks and their negations
+std::vector<int32_t> corner_operands(int bits) {
+    std::vector<int32_t> v;
+    int32_t min = -(1 << (bits - 1));
+    v.push_back(min);
+    v.push_back(min + 1);
+    v.push_back(0);
+    v.push_back(-1);        // All ones
+    for (int k = 0; k < bits - 1; k++) {
+        v.push_back(1 << k);
+        v.push_back(-(1 << k));
+        v.push_back((1 << (k + 1)) - 1);
+        v.push_back(-((1 << (k + 1)) - 1));
+        v.push_back(min | (1 << k));
+    }
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+    return v;
+}
+
+// Log-uniform signed magnitude up to 2^(bits-1), as seen in the SVF state registers
+int32_t log_uniform(std::mt19937_64& rng, int bits) {
+    int k = rng() % bits;
+    int32_t mag = (int32_t)(rng() & ((1ULL << k) - 1)) | (k ? (1 << (k - 1)) : 0);
+    return (rng() & 1) ? -mag : mag;
+}
+
+int run_verify(int argc, char** argv) {
+    unsigned threads  = sim_threads(argc, argv);
+    uint64_t seed     = get_plusarg_int(argc, argv, "seed", 1);
+    uint64_t count    = get_plusarg_int(argc, argv, "count", 1 << 20);
+
+    const auto corner_a = corner_operands(24);
+    const auto corner_b = corner_operands(16);
+
+    // Shard table: class and index within class
+    std::vector<std::pair<OpClass, uint64_t>> shards;
+    auto add_shards = [&](OpClass c, uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) shards.push_back({c, i});
+    };
+    add_shards(CLASS_CORNER, corner_a.size());
+    add_shards(CLASS_VOICE_ENV, 1024 / VOICE_ENV_A_PER_SHARD);
+    add_shards(CLASS_BYPASS_VOL, 16384 / BYPASS_VOL_A_PER_SHARD);
+    add_shards(CLASS_SVF, (count + RANDOM_PER_SHARD - 1) / RANDOM_PER_SHARD);
+    add_shards(CLASS_RANDOM, (count + RANDOM_PER_SHARD - 1) / RANDOM_PER_SHARD);
+
+    std::cout << "[TB] Multiplier Verification (seed " << seed << ", "
+              << threads << " threads, " << shards.size() << " shards)" << std::endl;
+
+    std::vector<std::unique_ptr<MultWorker>> workers(threads);
+    for (auto& w : workers) w.reset(new MultWorker);
+
+    std::atomic<uint64_t> ops[NUM_CLASSES]   = {};
+    std::atomic<uint64_t> fails[NUM_CLASSES] = {};
+    std::mutex log_mutex;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    parallel_for(shards.size(), threads, [&](size_t i, unsigned w) {
+        MultWorker& m = *workers[w];
+        OpClass  c     = shards[i].first;
+        uint64_t shard = shards[i].second;
+        std::mt19937_64 rng(seed * 0x9E3779B97F4A7C15ULL + i);
+
+        uint64_t n_ops = 0, n_fail = 0;
+        auto check = [&](int32_t a, int16_t b) {
+            int64_t got = m.run(a, b);
+            int64_t exp = mult_model(a, b);
+            n_ops++;
+            if (got != exp) {
+                if (n_fail++ == 0 && fails[c] == 0) {
+                    std::lock_guard<std::mutex> lock(log_mutex);
+                    std::cout << "[FAIL] " << CLASS_NAME[c] << "\tA: " << a << "\tB: " << b
+                              << "\t| Exp: " << exp << "\t| Got: " << got << std::endl;
+                }
+            }
+        };
+
+        switch (c) {
+            case CLASS_CORNER:
+                for (int32_t b : corner_b) check(corner_a[shard], (int16_t)b);
+                break;
+            case CLASS_VOICE_ENV:       // {{14{voice_wave[9]}}, voice_wave} x {8'd0, env_raw}
+                for (int a = 0; a < VOICE_ENV_A_PER_SHARD; a++)
+                    for (int b = 0; b < 256; b++)
+                        check((int32_t)(shard * VOICE_ENV_A_PER_SHARD + a) - 512, b);
+                break;
+            case CLASS_BYPASS_VOL:      // {{10{svf_bypass_sum[13]}}, svf_bypass_sum} x {8'd0, filt_volume}
+                for (int a = 0; a < BYPASS_VOL_A_PER_SHARD; a++)
+                    for (int b = 0; b < 256; b++)
+                        check((int32_t)(shard * BYPASS_VOL_A_PER_SHARD + a) - 8192, b);
+                break;
+            case CLASS_SVF:             // 24-bit state x Q1.15 coeff_f / Q4.12 coeff_q
+                for (uint64_t k = 0; k < RANDOM_PER_SHARD; k++) {
+                    int16_t b = (rng() % 8) ? (int16_t)log_uniform(rng, 16) : (int16_t)(rng() & 0x7FFF);
+                    if (b < 0 && (rng() % 4)) b = -b;
+                    check(log_uniform(rng, 24), b);
+                }
+                break;
+            case CLASS_RANDOM:
+                for (uint64_t k = 0; k < RANDOM_PER_SHARD; k++)
+                    check(wrap_signed<24>(rng()), (int16_t)rng());
+                break;
+            default:
+                break;
+        }
+
+        ops[c]   += n_ops;
+        fails[c] += n_fail;
+    });
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    uint64_t total_ops = 0, total_fail = 0, total_cycles = 0;
+    uint32_t min_lat = UINT32_MAX, max_lat = 0;
+    for (auto& w : workers) {
+        total_cycles += w->cycles;
+        min_lat = std::min(min_lat, w->min_lat);
+        max_lat = std::max(max_lat, w->max_lat);
+    }
+
+    std::printf("\n[TB] %-12s %12s %8s\n", "class", "ops", "failed");
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        std::printf("[TB] %-12s %12llu %8llu\n", CLASS_NAME[c],
+                    (unsigned long long)ops[c], (unsigned long long)fails[c]);
+        total_ops  += ops[c];
+        total_fail += fails[c];
+    }
+
+    std::printf("\n[TB] Multiplies:       %llu in %.2f s\n", (unsigned long long)total_ops, elapsed);
+    std::printf("[TB] Throughput:       %.2f M multiplies/s (%.2f M cycles/s)\n",
+                total_ops / elapsed / 1e6, total_cycles / elapsed / 1e6);
+    std::printf("[TB] Latency:          %u-%u cycles start_i to ready_o\n", min_lat, max_lat);
+    std::printf("[TB] Cycles/operation: %.2f back-to-back\n", (double)total_cycles / total_ops);
+    std::cout << "\n[TB] Tests Passed: " << total_ops - total_fail << std::endl;
+    std::cout << "[TB] Tests Failed: " << total_fail << std::endl;
+    return total_fail ? 1 : 0;
+}
+
 int main(int argc, char** argv) {
+    if (has_plusarg(argc, argv, "verify")) return run_verify(argc, argv);
+
     Verilated::mkdir("logs");
     const std::unique_ptr<VerilatedContext> contextp{new VerilatedContext};
     contextp->commandArgs(argc, argv);
-    contextp->traceEverOn(false);
+    contextp->traceEverOn(has_plusarg(argc, argv, "trace"));
     const std::unique_ptr<Vtb_mult> top{new Vtb_mult{contextp.get(), "TOP"}};
 
     // Initial pin state
@@ -100,5 +308,6 @@ int main(int argc, char** argv) {
 
     std::cout << "\n[TB] Tests Passed: " << pass_count << std::endl;
     std::cout << "[TB] Tests Failed: " << fail_count << std::endl;
+    report_stats(argc, argv, contextp, "mult");
     return 0;
 }
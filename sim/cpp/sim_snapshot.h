@@ -0,0 +1,93 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  File: sim_snapshot.h
+//  Description: In-memory save/restore of Verilated models built with --savable.
+//               Restoring a snapshot is much faster than constructing and
+//               resetting a new model, so scripted tests and fuzzers can
+//               rewind to a known state between runs.
+//
+//  Author:
+//    - Andreas Pedersen
+//
+//-------------------------------------------------------------------------------------------------
+
+#ifndef SIM_SNAPSHOT_H
+#define SIM_SNAPSHOT_H
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <verilated.h>
+#include <verilated_save.h>
+
+/**
+ * @brief Verilator serializer that appends to a byte string instead of a file.
+ */
+class MemSave : public VerilatedSerialize {
+public:
+    explicit MemSave(std::string& out) : out(out) { out.clear(); }
+    ~MemSave() override { flush(); }
+
+    void flush() override {
+        out.append(reinterpret_cast<const char*>(m_bufp), m_cp - m_bufp);
+        m_cp = m_bufp;
+    }
+
+private:
+    std::string& out;
+};
+
+/**
+ * @brief Verilator deserializer that reads from a byte string instead of a file.
+ */
+class MemRestore : public VerilatedDeserialize {
+public:
+    explicit MemRestore(const std::string& in) : in(in) { m_endp = m_bufp; }
+
+    void fill() override {
+        // Move the unread bytes down, then refill the buffer from the string
+        const size_t left = m_endp - m_cp;
+        std::memmove(m_bufp, m_cp, left);
+        m_cp   = m_bufp;
+        m_endp = m_bufp + left;
+
+        const size_t room = bufferSize() - left;
+        const size_t n    = std::min(room, in.size() - pos);
+        std::memcpy(m_endp, in.data() + pos, n);
+        pos    += n;
+        m_endp += n;
+
+        // Zero-pad like VerilatedRestore so reads never run past the end
+        std::memset(m_endp, 0, room - n);
+        m_endp += room - n;
+    }
+
+private:
+    const std::string& in;
+    size_t pos = 0;
+};
+
+/**
+ * @brief Saved state of a model and its simulation time.
+ *
+ * @tparam T  Verilator model type, verilated with --savable.
+ */
+template <typename T>
+struct Snapshot {
+    std::string state;
+    uint64_t    time = 0;
+
+    void save(const std::unique_ptr<VerilatedContext>& ctx, const std::unique_ptr<T>& top) {
+        MemSave os(state);
+        os << *top;
+        time = ctx->time();
+    }
+
+    void restore(const std::unique_ptr<VerilatedContext>& ctx, const std::unique_ptr<T>& top) const {
+        MemRestore is(state);
+        is >> *top;
+        ctx->time(time);
+    }
+};
+
+#endif // SIM_SNAPSHOT_H
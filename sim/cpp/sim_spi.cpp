@@ -3,6 +3,7 @@
 //  File: sim_spi.cpp
 //  Description: Verilator testbench for register SPI interface.
 //               Reads and writes test values and checks the reg_file interface.
+//               With +sweep, characterizes the maximum error-free write rate.
 //
 //  Author:
 //    - Andreas Pedersen
@@ -12,6 +13,11 @@
 #include "sim_common.h"
 #include "Vtb_spi.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
 const int SPI_CLK_DIV = 20;  // SPI clock = SysClk / 20 = 2.5 MHz
 
 uint8_t spi_bit(const std::unique_ptr<VerilatedContext>& ctx,
@@ -96,11 +102,224 @@ void check_read(const std::unique_ptr<VerilatedContext>& ctx,
     }
 }
 
+//=============================================================================
+// Throughput Sweep (+sweep)
+//=============================================================================
+
+// SPI bus timing in system clock cycles
+struct SpiTiming {
+    int high;       // SCLK high time
+    int low;        // SCLK low time (MOSI changes at the start of it)
+    int setup;      // CS low to first SCLK low phase
+    int hold;       // Last SCLK fall to CS high
+    int gap;        // CS high between frames
+
+    int frame_cycles() const { return setup + 16 * (high + low) + hold + gap; }
+};
+
+struct SweepResult {
+    SpiTiming t;
+    uint64_t  writes = 0;
+    uint64_t  reads  = 0;
+    uint64_t  write_errors = 0;
+    uint64_t  read_errors  = 0;
+
+    uint64_t errors() const { return write_errors + read_errors; }
+};
+
+/**
+ * @brief Run randomized write/read-back traffic at one bus timing.
+ *
+ * reg_file is modelled as a 128-byte array behind the reg_* port, with
+ * a combinational read like the RTL. A write frame must produce exactly
+ * one reg_we_o pulse with the right address and data; a read frame must
+ * produce none and shift out the stored byte on MISO.
+ */
+SweepResult run_traffic(const SpiTiming& t, int frames, uint64_t seed) {
+    const std::unique_ptr<VerilatedContext> ctx{new VerilatedContext};
+    ctx->traceEverOn(false);
+    const std::unique_ptr<Vtb_spi> top{new Vtb_spi{ctx.get(), "TOP"}};
+
+    uint8_t  mem[128] = {};
+    uint8_t  ref[128] = {};
+    int      we_count = 0;
+    uint8_t  we_addr  = 0;
+    uint8_t  we_data  = 0;
+
+    auto step = [&](int n) {
+        for (int i = 0; i < n; i++) {
+            tick(ctx, top);
+            if (top->reg_we_o) {
+                we_count++;
+                we_addr = top->reg_addr_o;
+                we_data = top->reg_wdata_o;
+                mem[top->reg_addr_o & 0x7F] = top->reg_wdata_o;
+            }
+            top->reg_rdata_i = mem[top->reg_addr_o & 0x7F];
+        }
+    };
+
+    top->clk_i  = 0;
+    top->rst_ni = 0;
+    top->sclk_i = 0;
+    top->cs_i   = 1;
+    top->mosi_i = 0;
+    step(5);
+    top->rst_ni = 1;
+    step(5);
+
+    std::mt19937_64 rng(seed);
+    SweepResult r;
+    r.t = t;
+
+    for (int f = 0; f < frames; f++) {
+        bool    write = rng() & 1;
+        uint8_t addr  = rng() & 0x7F;
+        uint8_t data  = rng() & 0xFF;
+        uint16_t frame = ((write ? 0x80 : 0x00) | addr) << 8 | (write ? data : 0x00);
+
+        we_count = 0;
+        uint8_t miso = 0;
+
+        top->cs_i = 0;
+        step(t.setup);
+        for (int i = 15; i >= 0; i--) {
+            top->mosi_i = (frame >> i) & 1;
+            step(t.low);
+            top->sclk_i = 1;
+            step(t.high);
+            if (i < 8) miso = (miso << 1) | top->miso_o;
+            top->sclk_i = 0;
+        }
+        step(t.hold);
+        top->cs_i = 1;
+        step(t.gap);
+
+        if (write) {
+            ref[addr] = data;
+            r.writes++;
+            if (we_count != 1 || we_addr != addr || we_data != data) r.write_errors++;
+        } else {
+            r.reads++;
+            if (we_count != 0 || miso != ref[addr]) r.read_errors++;
+        }
+    }
+
+    top->final();
+    return r;
+}
+
+int run_sweep(int argc, char** argv) {
+    unsigned threads = sim_threads(argc, argv);
+    int      frames  = get_plusarg_int(argc, argv, "frames", 512);
+    uint64_t seed    = get_plusarg_int(argc, argv, "seed", 1);
+    int      max_div = get_plusarg_int(argc, argv, "max_div", 20);
+
+    const int DUTY_PCT[] = {25, 50, 75};
+    const int SETUP[]    = {0, 1, 2, 4};
+    const int HOLD[]     = {0, 1, 2, 4};
+    const int GAP[]      = {1, 2, 3, 4, 8};
+
+    // Build the grid, skipping duty cycles that round to the same split
+    std::vector<SpiTiming> grid;
+    for (int div = 2; div <= max_div; div++) {
+        int last_high = -1;
+        for (int duty : DUTY_PCT) {
+            int high = std::clamp((div * duty + 50) / 100, 1, div - 1);
+            if (high == last_high) continue;
+            last_high = high;
+            for (int setup : SETUP)
+                for (int hold : HOLD)
+                    for (int gap : GAP)
+                        grid.push_back({high, div - high, setup, hold, gap});
+        }
+    }
+
+    std::cout << "[TB] SPI Throughput Sweep (" << grid.size() << " points, "
+              << frames << " frames each, " << threads << " threads)" << std::endl;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    std::vector<SweepResult> results(grid.size());
+    parallel_for(grid.size(), threads, [&](size_t i, unsigned) {
+        results[i] = run_traffic(grid[i], frames, seed + i);
+    });
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::ofstream csv("tmp/spi_sweep.csv");
+    if (!csv.is_open()) {
+        std::cerr << "[TB] Error: Could not open " << "tmp/spi_sweep.csv" << std::endl;
+        return 1;
+    }
+    csv << "div,high,low,setup,hold,gap,frame_cycles,writes,reads,write_errors,read_errors,writes_per_s,writes_per_sample\n";
+    for (const auto& r : results) {
+        int fc = r.t.frame_cycles();
+        csv << r.t.high + r.t.low << "," << r.t.high << "," << r.t.low << ","
+            << r.t.setup << "," << r.t.hold << "," << r.t.gap << "," << fc << ","
+            << r.writes << "," << r.reads << "," << r.write_errors << "," << r.read_errors << ","
+            << (double)CLK_FREQ_HZ / fc << "," << (double)CYCLES_PER_SAMPLE / fc << "\n";
+    }
+    csv.close();
+
+    // Per divider: passing points and the shortest passing frame
+    std::printf("\n[TB]  div  SCLK MHz  pass/total  best frame (cyc)  high/low/setup/hold/gap\n");
+    const SweepResult* best = nullptr;
+    for (int div = 2; div <= max_div; div++) {
+        int pass = 0, total = 0;
+        const SweepResult* div_best = nullptr;
+        for (const auto& r : results) {
+            if (r.t.high + r.t.low != div) continue;
+            total++;
+            if (r.errors()) continue;
+            pass++;
+            if (!div_best || r.t.frame_cycles() < div_best->t.frame_cycles()) div_best = &r;
+        }
+        if (div_best) {
+            std::printf("[TB] %4d %9.2f %5d/%-5d %17d  %d/%d/%d/%d/%d\n", div,
+                        CLK_FREQ_HZ / 1e6 / div, pass, total, div_best->t.frame_cycles(),
+                        div_best->t.high, div_best->t.low, div_best->t.setup,
+                        div_best->t.hold, div_best->t.gap);
+            if (!best || div_best->t.frame_cycles() < best->t.frame_cycles()) best = div_best;
+        } else {
+            std::printf("[TB] %4d %9.2f %5d/%-5d %17s\n", div, CLK_FREQ_HZ / 1e6 / div, pass, total, "-");
+        }
+    }
+
+    std::cout << "\n[TB] Finished in " << elapsed << " s" << std::endl;
+    if (!best) {
+        std::cout << "[TB] No error-free timing found" << std::endl;
+        return 1;
+    }
+
+    // Write-only hosts (the player) do not depend on MISO timing
+    const SweepResult* best_wr = nullptr;
+    for (const auto& r : results) {
+        if (r.write_errors) continue;
+        if (!best_wr || r.t.frame_cycles() < best_wr->t.frame_cycles()) best_wr = &r;
+    }
+
+    int fc = best->t.frame_cycles();
+    std::printf("[TB] Max error-free write rate: %.0f writes/s (%.2f per audio sample)\n",
+                (double)CLK_FREQ_HZ / fc, (double)CYCLES_PER_SAMPLE / fc);
+    std::printf("[TB]   %d cycles/frame: SCLK high %d, low %d, CS setup %d, hold %d, gap %d\n",
+                fc, best->t.high, best->t.low, best->t.setup, best->t.hold, best->t.gap);
+    fc = best_wr->t.frame_cycles();
+    std::printf("[TB] Write-only (no read-back):  %.0f writes/s (%.2f per audio sample)\n",
+                (double)CLK_FREQ_HZ / fc, (double)CYCLES_PER_SAMPLE / fc);
+    std::printf("[TB]   %d cycles/frame: SCLK high %d, low %d, CS setup %d, hold %d, gap %d\n",
+                fc, best_wr->t.high, best_wr->t.low, best_wr->t.setup, best_wr->t.hold, best_wr->t.gap);
+    std::cout << "[TB] Saved to tmp/spi_sweep.csv" << std::endl;
+    return 0;
+}
+
 int main(int argc, char** argv) {
+    if (has_plusarg(argc, argv, "sweep")) return run_sweep(argc, argv);
+
     Verilated::mkdir("logs");
     const std::unique_ptr<VerilatedContext> contextp{new VerilatedContext};
     contextp->commandArgs(argc, argv);
-    contextp->traceEverOn(false);
+    contextp->traceEverOn(has_plusarg(argc, argv, "trace"));
     const std::unique_ptr<Vtb_spi> top{new Vtb_spi{contextp.get(), "TOP"}};
 
     // Initial pin state
@@ -128,5 +347,6 @@ int main(int argc, char** argv) {
     top->final();
 
     std::cout << "[TB] Simulation finished." << std::endl;
+    report_stats(argc, argv, contextp, "spi");
     return 0;
 }
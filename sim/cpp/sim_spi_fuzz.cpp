@@ -0,0 +1,601 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  File: sim_spi_fuzz.cpp
+//  Description: Coverage-guided fuzzer for the SPI register interface.
+//               Drives arbitrary waveforms on SCLK/CS/MOSI into spi + reg_file
+//               and checks every clock against a pin-level model of the
+//               protocol. The model is rewound to a post-reset snapshot
+//               between inputs.
+//
+//  Author:
+//    - Andreas Pedersen
+//
+//-------------------------------------------------------------------------------------------------
+
+#include "sim_common.h"
+#include "sim_snapshot.h"
+#include "Vtb_spi_fuzz.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <random>
+
+const int NUM_REGS   = 27;  // reg_file registers, addresses 0x00-0x1A
+const int SYNC_DELAY = 2;   // Clocks from a pin to the SPI state machine
+const int FLUSH_TICKS = 8;  // CS high clocks after an input before the final check
+
+// Coverage features: controller-visible state edges, then frame endings
+const int    STATE_BITS     = 11;
+const size_t COV_EDGES      = size_t(1) << (2 * STATE_BITS);
+const size_t COV_FRAME_ENDS = 64;
+const size_t COV_SIZE       = COV_EDGES + COV_FRAME_ENDS;
+
+//=============================================================================
+// Input Format
+//=============================================================================
+
+/*
+ * An input is a byte string decoded into pin operations. Each operation
+ * starts with an opcode byte; bits [1:0] select the kind, the rest are
+ * parameters. Bytes past the end read as zero, so every string is valid.
+ *
+ *   PINS   sclk = b[2], cs = b[3], mosi = b[4], held for 1 + b[7:5] clocks
+ *   FRAME  cmd, data, timing: one 16-bit frame (cmd[7] write, address in
+ *          cmd[4:0], or cmd[6:0] if cmd[6]), SCLK low 1 + t[1:0] and high
+ *          1 + t[3:2] clocks, CS setup t[5:4] and hold t[7:6] clocks.
+ *          b[3:2] injects a fault at b[7:4]: 1 releases CS after that many
+ *          bits, 2 clocks 1 + b[5:4] bits past the 16th, 3 glitches CS high
+ *          before that bit for 1 + t[7:6] clocks.
+ *   IDLE   CS high, sclk = b[2], for 1 + b[7:3] clocks
+ *   BURST  CS low, 1 + b[7:2] single-clock SCLK phases, MOSI from the next byte
+ */
+enum OpKind { OP_PINS, OP_FRAME, OP_IDLE, OP_BURST };
+enum FrameFault { FAULT_NONE, FAULT_TRUNCATE, FAULT_EXTRA, FAULT_CS_GLITCH };
+
+const char* const FAULT_NAME[] = {"", " truncated", " extra bits", " CS glitch"};
+
+// One "[TB]   ..." line of a replay log
+template <typename... Args>
+std::string log_line(const char* fmt, Args... args) {
+    char buf[128];
+    std::snprintf(buf, sizeof(buf), fmt, args...);
+    return std::string("[TB]   ") + buf + "\n";
+}
+
+/**
+ * @brief Play an input as pin values, one call of clock(sclk, cs, mosi) per system clock.
+ *
+ * @param log  If given, receives one line per operation.
+ */
+template <typename ClockFn>
+void play_input(const std::string& in, ClockFn clock, std::string* log = nullptr) {
+    size_t pos = 0;
+    auto next = [&]() -> uint8_t { return pos < in.size() ? (uint8_t)in[pos++] : 0; };
+    auto hold = [&](int n, int sclk, int cs, int mosi) {
+        for (int i = 0; i < n; i++) clock(sclk, cs, mosi);
+    };
+
+    while (pos < in.size()) {
+        const uint8_t b = next();
+        switch (b & 3) {
+        case OP_PINS: {
+            const int sclk = (b >> 2) & 1, cs = (b >> 3) & 1, mosi = (b >> 4) & 1, n = 1 + (b >> 5);
+            if (log) *log += log_line("pins   sclk=%d cs=%d mosi=%d for %d", sclk, cs, mosi, n);
+            hold(n, sclk, cs, mosi);
+            break;
+        }
+        case OP_FRAME: {
+            const uint8_t cmd = next(), data = next(), t = next();
+            const bool    write = cmd & 0x80;
+            const uint8_t addr  = (cmd & 0x40) ? (cmd & 0x7F) : (cmd & 0x1F);
+            const int     low = 1 + (t & 3), high = 1 + ((t >> 2) & 3);
+            const int     setup = (t >> 4) & 3, cs_hold = t >> 6;
+            const int     fault = (b >> 2) & 3, param = b >> 4;
+
+            const uint16_t frame = (write ? 0x8000 : 0) | addr << 8 | (write ? data : 0);
+            int bits = 16;
+            if (fault == FAULT_TRUNCATE) bits = param;
+            if (fault == FAULT_EXTRA)    bits = 17 + (param & 3);
+
+            if (log) {
+                *log += log_line("frame  %s 0x%02X data 0x%02X low %d high %d setup %d hold %d%s%s",
+                                    write ? "write" : "read ", addr, data, low, high, setup, cs_hold,
+                                    FAULT_NAME[fault], fault ? (" at " + std::to_string(param)).c_str() : "");
+            }
+            hold(setup, 0, 0, 0);
+            for (int i = 0; i < bits; i++) {
+                if (fault == FAULT_CS_GLITCH && i == param) hold(1 + cs_hold, 0, 1, 0);
+                const int mosi = i < 16 ? (frame >> (15 - i)) & 1 : (data >> (7 - (i & 7))) & 1;
+                hold(low, 0, 0, mosi);
+                hold(high, 1, 0, mosi);
+            }
+            hold(1 + cs_hold, 0, 0, 0);
+            hold(1, 0, 1, 0);
+            break;
+        }
+        case OP_IDLE: {
+            const int sclk = (b >> 2) & 1, n = 1 + (b >> 3);
+            if (log) *log += log_line("idle   sclk=%d for %d", sclk, n);
+            hold(n, sclk, 1, 0);
+            break;
+        }
+        case OP_BURST: {
+            const int     n = 1 + (b >> 2);
+            const uint8_t mosi = next();
+            if (log) *log += log_line("burst  %d SCLK phases mosi 0x%02X", n, mosi);
+            for (int i = 0; i < n; i++) clock(i & 1, 0, (mosi >> (i & 7)) & 1);
+            break;
+        }
+        }
+    }
+}
+
+//=============================================================================
+// Protocol Reference
+//=============================================================================
+
+/**
+ * @brief Pin-level model of the register protocol.
+ *
+ * Works on the pins as the SPI block samples them, SYNC_DELAY clocks
+ * late, and knows nothing of its internals. While CS is low, each SCLK
+ * rise shifts in one MOSI bit. The first byte is the command (bit 7 write)
+ * and the 16th bit of a write frame writes the register. Bits past the
+ * 16th are ignored, or with repeat_extra each one writes the last 8 bits
+ * again, as spi.sv does. From the rise of bit 9 on, a read frame must
+ * present the register MSB first on MISO. CS high ends the frame at any
+ * point.
+ */
+class SpiReference {
+public:
+    struct Expect {
+        bool    we   = false;
+        uint8_t addr = 0;
+        uint8_t data = 0;
+        int     miso = -1;      // MISO before this clock, -1 if not checked
+        int     frame_end = -1; // Bits of a frame ended by CS this clock
+    };
+
+    uint8_t regs[NUM_REGS] = {};
+    bool    repeat_extra = false;
+
+    // Pin history, bit k is the value k clocks ago. Idle: CS high.
+    uint8_t sclk_h = 0;
+    uint8_t cs_h   = 0xFF;
+    uint8_t mosi_h = 0;
+
+    int      bits  = 0;
+    uint16_t shift = 0;
+    uint8_t  addr  = 0;
+    bool     write = false;
+    uint8_t  rdata = 0;
+
+    Expect clock(int sclk, int cs, int mosi) {
+        sclk_h = (sclk_h << 1) | sclk;
+        cs_h   = (cs_h << 1) | cs;
+        mosi_h = (mosi_h << 1) | mosi;
+
+        Expect e;
+        if ((cs_h >> SYNC_DELAY) & 1) {
+            if (bits) e.frame_end = (write && bits >= 8) << 5 | std::min(bits, 31);
+            bits = 0;
+            return e;
+        }
+
+        const bool rise = ((sclk_h >> SYNC_DELAY) & 3) == 1;
+        if (!rise) return e;
+
+        bits++;
+        if (bits > 16 && !repeat_extra) return e;
+        shift = (shift << 1) | ((mosi_h >> SYNC_DELAY) & 1);
+
+        if (bits == 8) {
+            addr  = shift & 0x7F;
+            write = (shift >> 7) & 1;
+            rdata = addr < NUM_REGS ? regs[addr] : 0;
+        }
+        if (bits > 8 && bits <= 16 && !write) e.miso = (rdata >> (16 - bits)) & 1;
+        if (bits >= 16 && write) {
+            e.we   = true;
+            e.addr = addr;
+            e.data = shift & 0xFF;
+            if (addr < NUM_REGS) regs[addr] = e.data;
+        }
+        return e;
+    }
+};
+
+//=============================================================================
+// Fuzzer
+//=============================================================================
+
+struct ExecResult {
+    bool        fail = false;
+    std::string what;           // First violation
+    uint64_t    fail_tick = 0;
+    uint64_t    ticks = 0;
+    uint64_t    hash  = 0;      // Hash of all outputs, for the determinism check
+};
+
+/**
+ * @brief One fuzzing instance: a model, its post-reset snapshot and a corpus.
+ *
+ * Coverage is the set of edges between consecutive SPI states (bit
+ * counter, command bit, CS, SCLK synchronizer, write strobe and MISO)
+ * plus the lengths of frames ended by CS. An input that reaches a new
+ * feature joins the corpus.
+ */
+class SpiFuzzer {
+public:
+    std::vector<std::string> corpus;
+    std::vector<uint8_t>     cov = std::vector<uint8_t>(COV_SIZE, 0);
+    uint64_t                 features = 0;
+    uint64_t                 execs = 0;
+    std::string              last;      // Input of the last step()
+
+    SpiFuzzer(int argc, char** argv, uint64_t seed, size_t max_len)
+        : ctx(new_context(argc, argv)), top(new Vtb_spi_fuzz{ctx.get(), "TOP"}), rng(seed), max_len(max_len) {
+        // spi.sv repeats the write for SCLK edges past the 16th (bit_cnt
+        // saturates); +extra_bits=ignore flags those writes as spurious
+        repeat_extra = get_plusarg(argc, argv, "extra_bits", "repeat") != "ignore";
+        top->clk_i  = 0;
+        top->rst_ni = 0;
+        top->sclk_i = 0;
+        top->cs_i   = 1;
+        top->mosi_i = 0;
+        for (int i = 0; i < 5; i++) tick(ctx, top);
+        top->rst_ni = 1;
+        for (int i = 0; i < 5; i++) tick(ctx, top);
+        reset.save(ctx, top);
+    }
+
+    ~SpiFuzzer() { top->final(); }
+
+    /**
+     * @brief Run one input from the post-reset state and check it.
+     *
+     * @param cover  Record coverage and count new features.
+     * @param log    If given, receives the operations, writes and the violation.
+     */
+    ExecResult run(const std::string& in, bool cover, std::string* log = nullptr) {
+        reset.restore(ctx, top);
+        SpiReference ref;
+        ExecResult   r;
+        ref.repeat_extra = repeat_extra;
+        r.hash = 1469598103934665603ull;
+        uint32_t prev = state();
+        const uint64_t before = features;
+
+        auto fail = [&](const char* fmt, auto... args) {
+            if (r.fail) return;
+            char msg[128];
+            std::snprintf(msg, sizeof(msg), fmt, args...);
+            r.fail = true;
+            r.what = msg;
+            r.fail_tick = r.ticks;
+        };
+
+        auto clock = [&](int sclk, int cs, int mosi) {
+            const int miso = top->miso_o;
+            top->sclk_i = sclk;
+            top->cs_i   = cs;
+            top->mosi_i = mosi;
+            tick(ctx, top);
+            r.ticks++;
+
+            const SpiReference::Expect e = ref.clock(sclk, cs, mosi);
+            if (e.miso >= 0 && miso != e.miso) {
+                fail("read of 0x%02X: MISO bit %d is %d, expected %d",
+                     ref.addr, 16 - ref.bits, miso, e.miso);
+            }
+            if (top->reg_we_o && !e.we) {
+                fail("spurious reg_we: addr 0x%02X data 0x%02X (frame bit %d)",
+                     top->reg_addr_o, top->reg_wdata_o, ref.bits);
+            } else if (e.we && !top->reg_we_o) {
+                fail("missing reg_we: addr 0x%02X data 0x%02X", e.addr, e.data);
+            } else if (e.we && (top->reg_addr_o != e.addr || top->reg_wdata_o != e.data)) {
+                fail("wrong write: addr 0x%02X data 0x%02X, expected 0x%02X 0x%02X",
+                     top->reg_addr_o, top->reg_wdata_o, e.addr, e.data);
+            }
+            if (log && e.we) {
+                *log += log_line("  tick %llu: write 0x%02X = 0x%02X",
+                                 (unsigned long long)r.ticks, e.addr, e.data);
+            }
+
+            const uint32_t s = state();
+            r.hash = (r.hash ^ (s | top->reg_addr_o << 11 | top->reg_wdata_o << 18)) * 1099511628211ull;
+            if (cover) {
+                mark((size_t)prev << STATE_BITS | s);
+                if (e.frame_end >= 0) mark(COV_EDGES + e.frame_end);
+            }
+            prev = s;
+        };
+
+        play_input(in, clock, log);
+        for (int i = 0; i < FLUSH_TICKS; i++) clock(0, 1, 0);
+
+        for (int a = 0; a < NUM_REGS && !r.fail; a++) {
+            if (top->regs_o[a] != ref.regs[a]) {
+                fail("register 0x%02X holds 0x%02X, expected 0x%02X", a, top->regs_o[a], ref.regs[a]);
+            }
+        }
+
+        if (log && r.fail) {
+            *log += log_line("violation at tick %llu: %s", (unsigned long long)r.fail_tick, r.what.c_str());
+        }
+        execs++;
+        new_features = features - before;
+        return r;
+    }
+
+    /**
+     * @brief Mutate a corpus entry, run it and keep it if it adds coverage.
+     *
+     * Inputs that add coverage are run a second time: a two-state model
+     * has no X to assert on, so any state the snapshot misses (or any
+     * other source of nondeterminism) shows up as a different trace.
+     *
+     * @return  The result; a failing input is left in `last`.
+     */
+    ExecResult step() {
+        last = corpus.empty() ? std::string() : corpus[rng() % corpus.size()];
+        const int n = 1 + rng() % 4;
+        for (int i = 0; i < n; i++) mutate(last);
+
+        ExecResult r = run(last, true);
+        if (!r.fail && new_features) {
+            const ExecResult again = run(last, false);
+            if (again.hash != r.hash) {
+                r.fail = true;
+                r.what = "nondeterministic: replay from the snapshot gave a different trace";
+            }
+            corpus.push_back(last);
+        }
+        return r;
+    }
+
+private:
+    const std::unique_ptr<VerilatedContext> ctx;
+    const std::unique_ptr<Vtb_spi_fuzz>     top;
+    Snapshot<Vtb_spi_fuzz> reset;
+    std::mt19937_64        rng;
+    size_t                 max_len;
+    bool                   repeat_extra;
+    uint64_t               new_features = 0;
+
+    // Tracing has to be enabled before the model is built
+    static VerilatedContext* new_context(int argc, char** argv) {
+        VerilatedContext* ctx = new VerilatedContext;
+        ctx->commandArgs(argc, argv);
+        ctx->traceEverOn(has_plusarg(argc, argv, "trace") && has_plusarg(argc, argv, "replay"));
+        return ctx;
+    }
+
+    uint32_t state() const {
+        return top->bit_cnt_o | top->is_write_o << 4 | top->cs_active_o << 5 |
+               top->sclk_sync_o << 6 | top->reg_we_o << 9 | top->miso_o << 10;
+    }
+
+    void mark(size_t i) {
+        if (!cov[i]) {
+            cov[i] = 1;
+            features++;
+        }
+    }
+
+    // libFuzzer-style byte mutations
+    void mutate(std::string& s) {
+        static const uint8_t INTERESTING[] = {0x00, 0x01, 0x7F, 0x80, 0x81, 0xFF};
+        const size_t len = s.size();
+        switch (rng() % 7) {
+        case 0:     // Flip a bit
+            if (len) s[rng() % len] ^= 1 << (rng() % 8);
+            break;
+        case 1:     // Random byte
+            if (len) s[rng() % len] = (char)rng();
+            break;
+        case 2:     // Interesting byte
+            if (len) s[rng() % len] = (char)INTERESTING[rng() % sizeof(INTERESTING)];
+            break;
+        case 3: {   // Insert random bytes
+            std::string ins(1 + rng() % 4, '\0');
+            for (auto& c : ins) c = (char)rng();
+            s.insert(rng() % (len + 1), ins);
+            break;
+        }
+        case 4:     // Erase a range
+            if (len) {
+                const size_t at = rng() % len;
+                s.erase(at, 1 + rng() % std::min<size_t>(len - at, 8));
+            }
+            break;
+        case 5:     // Duplicate a range
+            if (len) {
+                const size_t at = rng() % len;
+                s.insert(rng() % (len + 1), s.substr(at, 1 + rng() % std::min<size_t>(len - at, 8)));
+            }
+            break;
+        case 6:     // Splice in part of another corpus entry
+            if (!corpus.empty()) {
+                const std::string& o = corpus[rng() % corpus.size()];
+                if (!o.empty()) {
+                    const size_t at = rng() % o.size();
+                    s.insert(rng() % (len + 1), o.substr(at, 1 + rng() % (o.size() - at)));
+                }
+            }
+            break;
+        }
+        if (s.size() > max_len) s.resize(max_len);
+    }
+};
+
+/**
+ * @brief Shrink a failing input by removing byte ranges while it still fails.
+ */
+std::string minimize(SpiFuzzer& fz, std::string in) {
+    for (size_t chunk = std::max<size_t>(in.size() / 2, 1); chunk >= 1; chunk /= 2) {
+        for (size_t at = 0; at + chunk <= in.size();) {
+            std::string cand = in.substr(0, at) + in.substr(at + chunk);
+            if (fz.run(cand, false).fail) in = cand;
+            else                          at += chunk;
+        }
+    }
+    return in;
+}
+
+std::string to_hex(const std::string& s) {
+    std::string out;
+    char b[4];
+    for (unsigned char c : s) {
+        std::snprintf(b, sizeof(b), "%02X ", c);
+        out += b;
+    }
+    if (!out.empty()) out.pop_back();
+    return out;
+}
+
+// Well-formed traffic the fuzzer starts from
+std::vector<std::string> seed_inputs() {
+    const uint8_t WRITE_READ[] = {0x01, 0x80 | 0x04, 0x5A, 0x05,    // write ctrl0 = 0x5A
+                                  0x01, 0x04, 0x00, 0x05,           // read it back
+                                  0x01, 0x80 | 0x1A, 0xC3, 0x00,    // write volume, fastest timing
+                                  0x01, 0x1A, 0x00, 0xFF};          // read it, slowest timing
+    const uint8_t IDLE[] = {0x02 | 7 << 3};
+    return {std::string(WRITE_READ, WRITE_READ + sizeof(WRITE_READ)),
+            std::string(IDLE, IDLE + sizeof(IDLE))};
+}
+
+int run_replay(int argc, char** argv) {
+    const std::string path = get_plusarg(argc, argv, "replay", "");
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "[TB] Could not open " << path << std::endl;
+        return 1;
+    }
+    const std::string in((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // The TB dumps only with +replay, so a single input is traced from reset
+    Verilated::mkdir("logs");
+    SpiFuzzer   fz(argc, argv, 1, in.size());
+    std::string log;
+    ExecResult  r = fz.run(in, false, &log);
+
+    std::cout << "[TB] Replay " << path << " (" << in.size() << " bytes, " << r.ticks << " ticks)\n"
+              << "[TB]   " << to_hex(in) << "\n" << log;
+    std::cout << "[TB] " << (r.fail ? "FAIL" : "PASS") << std::endl;
+    return r.fail ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    if (has_plusarg(argc, argv, "replay")) return run_replay(argc, argv);
+
+    unsigned threads  = sim_threads(argc, argv);
+    uint64_t max_execs = get_plusarg_int(argc, argv, "execs", 200000);
+    double   max_time = get_plusarg_int(argc, argv, "max_time", 0);
+    uint64_t seed     = get_plusarg_int(argc, argv, "seed", 1);
+    size_t   max_len  = get_plusarg_int(argc, argv, "max_len", 64);
+
+    std::cout << "[TB] SPI Register Fuzzer (" << max_execs << " execs, max_len " << max_len
+              << ", seed " << seed << ", " << threads << " threads)" << std::endl;
+
+    auto t0 = std::chrono::steady_clock::now();
+    auto elapsed = [&] { return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count(); };
+
+    std::vector<std::unique_ptr<SpiFuzzer>> fuzzers(threads);
+    std::atomic<uint64_t> total{0};
+    std::atomic<bool>     stop{false};
+    std::mutex            fail_mutex;
+    ExecResult            failure;
+    std::string           failing;
+
+    // Keep the first failure of any thread and stop the others
+    auto report = [&](const std::string& in, const ExecResult& r) {
+        std::lock_guard<std::mutex> lock(fail_mutex);
+        if (stop.exchange(true)) return;
+        failing = in;
+        failure = r;
+    };
+
+    parallel_for(threads, threads, [&](size_t i, unsigned) {
+        fuzzers[i].reset(new SpiFuzzer(argc, argv, seed + 7919 * i, max_len));
+        SpiFuzzer& fz = *fuzzers[i];
+
+        for (const auto& s : seed_inputs()) {
+            ExecResult r = fz.run(s, true);
+            if (r.fail) report(s, r);
+            fz.corpus.push_back(s);
+        }
+
+        uint64_t next_status = 1024;
+        while (!stop) {
+            const uint64_t n = ++total;
+            if (n > max_execs || (max_time > 0 && (n & 255) == 0 && elapsed() > max_time)) break;
+
+            ExecResult r = fz.step();
+            if (r.fail) {
+                report(fz.last, r);
+                break;
+            }
+
+            if (i == 0 && n >= next_status) {
+                std::printf("[TB] #%llu cov: %llu corp: %zu exec/s: %.0f\n", (unsigned long long)n,
+                            (unsigned long long)fz.features, fz.corpus.size(), n / elapsed());
+                std::fflush(stdout);
+                next_status *= 2;
+            }
+        }
+    });
+
+    const double secs  = elapsed();
+    uint64_t     execs = 0;
+    size_t       corp  = 0;
+    std::vector<uint8_t> cov(COV_SIZE, 0);
+    for (const auto& fz : fuzzers) {
+        execs += fz->execs;
+        corp  += fz->corpus.size();
+        for (size_t i = 0; i < COV_SIZE; i++) cov[i] |= fz->cov[i];
+    }
+    const uint64_t edges = std::count(cov.begin(), cov.begin() + COV_EDGES, 1);
+
+    std::printf("\n[TB] %llu execs in %.2f s (%.0f exec/s), %llu state edges, corpus %zu\n",
+                (unsigned long long)execs, secs, execs / secs, (unsigned long long)edges, corp);
+
+    // Which frame lengths the inputs ended with CS, by command
+    for (int write = 0; write < 2; write++) {
+        std::string seen;
+        for (int bits = 1; bits < 32; bits++) {
+            if (cov[COV_EDGES + (write << 5 | bits)]) seen += " " + std::to_string(bits);
+        }
+        std::printf("[TB]   %s frames ended after bits:%s\n", write ? "write" : "other", seen.empty() ? " -" : seen.c_str());
+    }
+
+    if (!failure.fail) {
+        std::cout << "[TB] No violations" << std::endl;
+        return 0;
+    }
+
+    // Minimize, save and replay the failing input
+    SpiFuzzer   fz(argc, argv, seed, max_len);
+    std::string min = minimize(fz, failing);
+    std::string log;
+    ExecResult  r = fz.run(min, false, &log);
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "tmp/spi_fuzz_crash_%016llx.bin", (unsigned long long)r.hash);
+    Verilated::mkdir("tmp");
+    std::ofstream crash(name, std::ios::binary);
+    crash << min;
+
+    std::cout << "\n[TB] FAIL: " << (r.fail ? r.what : failure.what) << "\n"
+              << "[TB] Minimized from " << failing.size() << " to " << min.size() << " bytes: "
+              << to_hex(min) << "\n" << log;
+    if (!crash.is_open()) {
+        std::cerr << "[TB] Error: Could not open " << name << std::endl;
+        return 1;
+    }
+    std::cout << "[TB] Saved to " << name << " (replay with +replay=" << name << ")" << std::endl;
+    return 1;
+}
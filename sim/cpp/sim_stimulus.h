@@ -0,0 +1,105 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  File: sim_stimulus.h
+//  Description: SID stimulus files (clk_tick addr data), as played by the
+//               tt6581 player and written by +reg_log.
+//
+//  Author:
+//    - Andreas Pedersen
+//
+//-------------------------------------------------------------------------------------------------
+
+#ifndef SIM_STIMULUS_H
+#define SIM_STIMULUS_H
+
+#include "sim_common.h"
+
+#include <cstdlib>
+#include <cstring>
+
+const char* const DEFAULT_STIMULUS = "stimulus/Hubbard_Rob_Monty_on_the_Run_tt6581_stimulus.txt";
+
+const uint8_t LAST_REG_ADDR = FILT_BASE + REG_VOLUME;   // Highest mapped register
+
+struct StimulusEvent {
+    uint64_t clk_tick;
+    uint8_t  addr;
+    uint8_t  data;
+};
+
+// Parse the next number on a line (hex with an optional 0x) and advance past it
+inline uint64_t parse_uint(const char*& p, const char* eol, int base) {
+    while (p < eol && (*p == ' ' || *p == '\t')) p++;
+    if (base == 16 && eol - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) p += 2;
+
+    uint64_t v = 0;
+    for (; p < eol; p++) {
+        int d;
+        if (*p >= '0' && *p <= '9')                    d = *p - '0';
+        else if (base == 16 && (*p | 0x20) >= 'a' && (*p | 0x20) <= 'f') d = (*p | 0x20) - 'a' + 10;
+        else break;
+        v = v * base + d;
+    }
+    return v;
+}
+
+/**
+ * @brief Load a stimulus file.
+ *
+ * One write per line: decimal clock tick, then hex address and data.
+ * Lines starting with '#' are comments; the player frame rate is taken
+ * from a "# Frames: N @ R Hz" header if there is one. The file is parsed
+ * from one buffer, so multi-million-write files load in a fraction of a
+ * second.
+ *
+ * @param path      Stimulus file.
+ * @param frame_hz  Set to the header frame rate if given (may be null).
+ * @return          Writes in file order, empty if the file could not be read.
+ */
+inline std::vector<StimulusEvent> load_stimulus(const std::string& path, double* frame_hz = nullptr) {
+    std::vector<StimulusEvent> events;
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return events;
+
+    file.seekg(0, std::ios::end);
+    std::string text(file.tellg(), '\0');
+    file.seekg(0);
+    file.read(&text[0], text.size());
+    events.reserve(text.size() / 16);
+
+    const char* p   = text.c_str();
+    const char* end = p + text.size();
+    while (p < end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+
+        while (p < eol && (*p == ' ' || *p == '\t')) p++;
+        if (p < eol && *p == '#') {
+            const char* at = static_cast<const char*>(std::memchr(p, '@', eol - p));
+            if (frame_hz && at && std::strncmp(p, "# Frames:", 9) == 0) {
+                *frame_hz = std::strtod(at + 1, nullptr);
+            }
+        } else if (p < eol && *p >= '0' && *p <= '9') {
+            StimulusEvent ev;
+            ev.clk_tick = parse_uint(p, eol, 10);
+            ev.addr     = (uint8_t)parse_uint(p, eol, 16);
+            ev.data     = (uint8_t)parse_uint(p, eol, 16);
+            events.push_back(ev);
+        }
+        p = eol + 1;
+    }
+
+    return events;
+}
+
+/**
+ * @brief System clocks one spi_write() frame occupies the bus.
+ *
+ * 16 SCLK periods of 2 * (spi_div / 2) clocks, the CS hold half period
+ * and the 20-clock gap after CS is released.
+ */
+inline uint64_t spi_frame_ticks(int spi_div) {
+    return 33 * (uint64_t)(spi_div / 2) + 20;
+}
+
+#endif // SIM_STIMULUS_H
@@ -3,6 +3,9 @@
 //  File: sim_svf.cpp
 //  Description: Verilator testbench for Chamberlin State-Variable filter.
 //               Inputs a sine sweep and logs output for all 4 filter modes.
+//               With +explore, sweeps the 16-bit coefficient space on a
+//               bit-exact model and maps stable/limit-cycle/unstable regions.
+//               With +mls, measures all 4 responses from an MLS excitation.
 //
 //  Author:
 //    - Andreas Pedersen
@@ -10,14 +13,20 @@
 //-------------------------------------------------------------------------------------------------
 
 #include "sim_common.h"
+#include "sim_model.h"
+#include "sim_dsp.h"
 #include "Vtb_svf.h"
 
 #include <vector>
+#include <complex>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 
 struct FilterMode {
     std::string name;
     int mode_bits;
-    std::string filename;
+    std::string filename;   // Without extension
 };
 
 // Run one sample through the filter state machine
@@ -36,17 +45,413 @@ void run_sample(const std::unique_ptr<VerilatedContext>& ctx,
     tick(ctx, top);
 }
 
+//=============================================================================
+// Coefficient-space explorer (+explore)
+//=============================================================================
+
+const int MODE_SEL[4]           = {0b001, 0b010, 0b100, 0b101};
+const char* const MODE_NAME[4]  = {"lp", "bp", "hp", "br"};
+
+const int IMPULSE_SAMPLES = 8192;    // Impulse response length
+const int CYCLE_PROBE     = 65536;   // Max samples searched for a limit-cycle period
+const int MAX_SETTLE      = 8192;    // Max settle time before tone measurement
+const int TONE_SAMPLES    = 2048;    // Samples per tone measurement
+
+enum class SvfClass { STABLE, LIMIT_CYCLE, UNSTABLE };
+
+struct ExploreResult {
+    int16_t  coeff_f;
+    int16_t  coeff_q;
+    bool     ideal_stable;
+    SvfClass cls;
+    int      period;                // Zero-input limit cycle period (0 = none/unknown)
+    int32_t  tail_amp;              // Peak |reg_low|/|reg_band| left after the impulse
+    double   peak_gain_db[4];       // Measured peak gain per mode over the test tones
+    double   sat_rate[4];           // Fraction of saturated samples, full-scale sine at fc
+    double   max_dev_db;            // Max |measured - ideal| over test tones and modes
+};
+
+/**
+ * @brief Ideal (infinite precision) Chamberlin SVF magnitude response.
+ *
+ * H_lp = f^2 / D, H_bp = f(1 - z^-1) / D, H_hp = (1 - z^-1)^2 / D,
+ * D = 1 + (f^2 + qf - 2) z^-1 + (1 - qf) z^-2.
+ */
+double ideal_gain(double f, double q, int mode, double freq_hz) {
+    std::complex<double> z1 = std::polar(1.0, -2.0 * M_PI * freq_hz / SAMPLE_RATE_HZ);
+    std::complex<double> d  = 1.0 + (f * f + q * f - 2.0) * z1 + (1.0 - q * f) * z1 * z1;
+    std::complex<double> hp = (1.0 - z1) * (1.0 - z1);
+    std::complex<double> num;
+    switch (mode) {
+        case 0:  num = f * f;          break;
+        case 1:  num = f * (1.0 - z1); break;
+        case 2:  num = hp;             break;
+        default: num = hp + f * f;     break;
+    }
+    return std::abs(num / d);
+}
+
+/**
+ * @brief Drive a sine through the model and measure the output of all modes.
+ *
+ * Amplitudes are taken by I/Q correlation over TONE_SAMPLES after settling.
+ */
+void measure_tone(int16_t cf, int16_t cq, double freq_hz, double amp, int settle,
+                  double gain[4], double sat[4]) {
+    SvfModel m;
+    double w = 2.0 * M_PI * freq_hz / SAMPLE_RATE_HZ;
+    double acc_i[4] = {}, acc_q[4] = {};
+    int    sat_cnt[4] = {};
+
+    for (int n = 0; n < settle + TONE_SAMPLES; n++) {
+        m.step((int16_t)std::lround(amp * std::sin(w * n)), cf, cq);
+        if (n < settle) continue;
+        for (int k = 0; k < 4; k++) {
+            int32_t raw = m.selected(MODE_SEL[k]);
+            if (raw > 8191 || raw < -8192) sat_cnt[k]++;
+            double y = m.output(MODE_SEL[k]);
+            acc_i[k] += y * std::sin(w * n);
+            acc_q[k] += y * std::cos(w * n);
+        }
+    }
+
+    for (int k = 0; k < 4; k++) {
+        double a = 2.0 / TONE_SAMPLES * std::hypot(acc_i[k], acc_q[k]);
+        gain[k] = a / amp;
+        sat[k]  = (double)sat_cnt[k] / TONE_SAMPLES;
+    }
+}
+
+ExploreResult explore_point(int16_t cf, int16_t cq) {
+    ExploreResult r{};
+    r.coeff_f = cf;
+    r.coeff_q = cq;
+
+    double f = cf / 32768.0;
+    double q = cq / 4096.0;
+    r.ideal_stable = (q * f > 0.0) && (q * f < 2.0) && (f * f + 2.0 * q * f < 4.0);
+
+    // Impulse response: classify decay, zero-input limit cycle or divergence
+    SvfModel m;
+    int32_t peak_a = 0, peak_b = 0;
+    m.step(8191, cf, cq);
+    for (int n = 1; n < IMPULSE_SAMPLES && !m.wrapped; n++) {
+        m.step(0, cf, cq);
+        int32_t a = std::max(std::abs(m.reg_low), std::abs(m.reg_band));
+        if (n >= IMPULSE_SAMPLES / 2 && n < 3 * IMPULSE_SAMPLES / 4) peak_a = std::max(peak_a, a);
+        if (n >= 3 * IMPULSE_SAMPLES / 4)                            peak_b = std::max(peak_b, a);
+    }
+
+    r.tail_amp = peak_b;
+    if (m.wrapped || peak_b > peak_a + 1) {
+        r.cls = SvfClass::UNSTABLE;
+    } else if (m.reg_band == 0 && m.reg_low == 0 && m.hp_node == 0) {
+        r.cls = SvfClass::STABLE;
+    } else if (peak_b < peak_a - peak_a / 100) {
+        r.cls = SvfClass::STABLE;   // Still decaying, just slowly
+    } else {
+        // Zero input and a non-zero state that no longer decays: find the period
+        r.cls = SvfClass::LIMIT_CYCLE;
+        int32_t band0 = m.reg_band, low0 = m.reg_low;
+        for (int n = 1; n <= CYCLE_PROBE && !m.wrapped; n++) {
+            m.step(0, cf, cq);
+            if (m.reg_band == band0 && m.reg_low == low0) {
+                r.period = n;
+                break;
+            }
+        }
+        if (m.wrapped) r.cls = SvfClass::UNSTABLE;
+    }
+
+    for (int k = 0; k < 4; k++) {
+        r.peak_gain_db[k] = NAN;
+        r.sat_rate[k]     = NAN;
+    }
+    r.max_dev_db = NAN;
+
+    // Frequency-domain metrics only make sense for a stable filter with a real cutoff
+    if (r.cls == SvfClass::UNSTABLE || !r.ideal_stable || f <= 0.0 || f >= 2.0) return r;
+
+    double fc      = std::asin(f / 2.0) * SAMPLE_RATE_HZ / M_PI;
+    int    settle  = (int)std::min<double>(MAX_SETTLE, 10.0 / (q * f));
+    double tones[3] = {fc / 2.0, fc, std::min(fc * 2.0, 0.45 * SAMPLE_RATE_HZ)};
+
+    // Keep the ideal output below full scale so the deviation is not saturation
+    double ideal_peak = 1.0;
+    for (double t : tones)
+        for (int k = 0; k < 4; k++) ideal_peak = std::max(ideal_peak, ideal_gain(f, q, k, t));
+    double amp = std::min(4096.0, 6000.0 / ideal_peak);
+
+    double gain[4], sat[4];
+    r.max_dev_db = 0.0;
+    for (int k = 0; k < 4; k++) r.peak_gain_db[k] = -INFINITY;
+
+    for (double t : tones) {
+        measure_tone(cf, cq, t, amp, settle, gain, sat);
+        for (int k = 0; k < 4; k++) {
+            double meas_db  = 20.0 * std::log10(std::max(gain[k], 1e-9));
+            double ideal_db = 20.0 * std::log10(std::max(ideal_gain(f, q, k, t), 1e-9));
+            r.peak_gain_db[k] = std::max(r.peak_gain_db[k], meas_db);
+            // Ignore the deep stopband, where the output is only a few LSBs
+            if (ideal_db > -40.0) r.max_dev_db = std::max(r.max_dev_db, std::abs(meas_db - ideal_db));
+        }
+    }
+
+    measure_tone(cf, cq, fc, 8191.0, settle, gain, sat);
+    for (int k = 0; k < 4; k++) r.sat_rate[k] = sat[k];
+
+    return r;
+}
+
+// Coefficient points the model is checked on before trusting it for the sweep
+const std::pair<int16_t, int16_t> CHECK_POINTS[] = {
+    {get_coeff_f(1000.0),  get_coeff_q(0.707)},
+    {get_coeff_f(100.0),   get_coeff_q(8.0)},
+    {get_coeff_f(8000.0),  get_coeff_q(2.0)},
+    {get_coeff_f(15000.0), get_coeff_q(0.5)},
+    {(int16_t)0x7FFF,      (int16_t)0x7FFF},
+    {(int16_t)0x8000,      (int16_t)0x1000},
+};
+const size_t NUM_CHECK_POINTS = sizeof(CHECK_POINTS) / sizeof(CHECK_POINTS[0]);
+
+// Check the model against the RTL at one coefficient point with random input
+bool check_model(int16_t coeff_f, int16_t coeff_q, uint32_t seed) {
+    const std::unique_ptr<VerilatedContext> ctx{new VerilatedContext};
+    ctx->traceEverOn(false);
+    const std::unique_ptr<Vtb_svf> top{new Vtb_svf{ctx.get(), "TOP"}};
+
+    top->clk_i      = 0;
+    top->rst_ni     = 0;
+    top->coeff_f_i  = coeff_f;
+    top->coeff_q_i  = coeff_q;
+    for (int i = 0; i < 5; i++) tick(ctx, top);
+    top->rst_ni = 1;
+    for (int i = 0; i < 5; i++) tick(ctx, top);
+
+    SvfModel m;
+    uint32_t lfsr = seed;
+    bool ok = true;
+    for (int n = 0; n < 2000 && ok; n++) {
+        lfsr = lfsr * 1664525u + 1013904223u;
+        int16_t in  = (int16_t)(((lfsr >> 16) & 0x3FFF) << 2) >> 2;
+        int     sel = MODE_SEL[n % 4];
+
+        top->wave_i     = in & 0x3FFF;
+        top->filt_sel_i = sel;
+        run_sample(ctx, top);
+        m.step(in, coeff_f, coeff_q);
+
+        int16_t rtl = (int16_t)(top->wave_o << 2) >> 2;
+        if (rtl != m.output(sel)) {
+            std::cerr << "[TB] Model mismatch at f=" << coeff_f << " q=" << coeff_q
+                      << " n=" << n << ": RTL " << rtl << " model " << m.output(sel) << std::endl;
+            ok = false;
+        }
+    }
+    top->final();
+    return ok;
+}
+
+int run_explore(int argc, char** argv) {
+    int      stride  = (int)get_plusarg_int(argc, argv, "stride", 256);
+    unsigned threads = sim_threads(argc, argv);
+    std::string path = get_plusarg(argc, argv, "out", "tmp/svf_explore.csv");
+
+    std::cout << "[TB] SVF Coefficient Explorer" << std::endl;
+    std::cout << "[TB] Checking model against RTL..." << std::endl;
+    if (!check_model_parallel(NUM_CHECK_POINTS, threads, [&](size_t i) {
+            return check_model(CHECK_POINTS[i].first, CHECK_POINTS[i].second, check_seed(i));
+        })) return 1;
+    std::cout << "[TB] Model is bit-exact" << std::endl;
+
+    std::vector<int16_t> grid;
+    for (int v = -32768; v <= 32767; v += stride) grid.push_back((int16_t)v);
+    if (grid.back() != 32767) grid.push_back(32767);
+
+    size_t n = grid.size() * grid.size();
+    std::cout << "[TB] Sweeping " << grid.size() << "x" << grid.size() << " coefficients (stride "
+              << stride << ") on " << threads << " threads" << std::endl;
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<ExploreResult> results(n);
+    parallel_for(n, threads, [&](size_t i, unsigned) {
+        results[i] = explore_point(grid[i % grid.size()], grid[i / grid.size()]);
+    });
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::ofstream csv(path);
+    if (!csv.is_open()) {
+        std::cerr << "[TB] Error: Could not open " << path << std::endl;
+        return 1;
+    }
+    const char* cls_name[] = {"stable", "limit_cycle", "unstable"};
+    csv << "coeff_f,coeff_q,fc_hz,q,ideal_stable,class,period,tail_amp";
+    for (auto name : MODE_NAME) csv << ",peak_gain_db_" << name;
+    for (auto name : MODE_NAME) csv << ",sat_rate_" << name;
+    csv << ",max_dev_db\n";
+    for (const auto& r : results) {
+        double f  = r.coeff_f / 32768.0;
+        double fc = (f > 0.0 && f < 2.0) ? std::asin(f / 2.0) * SAMPLE_RATE_HZ / M_PI : NAN;
+        csv << r.coeff_f << "," << r.coeff_q << "," << fc << ","
+            << (r.coeff_q != 0 ? 4096.0 / r.coeff_q : NAN) << ","
+            << r.ideal_stable << "," << cls_name[(int)r.cls] << ","
+            << r.period << "," << r.tail_amp;
+        for (double g : r.peak_gain_db) csv << "," << g;
+        for (double s : r.sat_rate)     csv << "," << s;
+        csv << "," << r.max_dev_db << "\n";
+    }
+    csv.close();
+
+    // Safe region per damping value: contiguous stable coeff_f from the bottom up
+    std::string safe_path = path.substr(0, path.rfind('.')) + "_safe.csv";
+    std::ofstream safe(safe_path);
+    if (!safe.is_open()) {
+        std::cerr << "[TB] Error: Could not open " << safe_path << std::endl;
+        return 1;
+    }
+    safe << "coeff_q,q,max_safe_coeff_f,max_safe_fc_hz,first_limit_cycle_f,first_unstable_f\n";
+    std::cout << "\n[TB]  coeff_q       Q   max safe coeff_f   fc (Hz)   limit cycle at   unstable at" << std::endl;
+    for (size_t qi = 0; qi < grid.size(); qi++) {
+        if (grid[qi] <= 0) continue;
+        int max_safe = -1, first_lc = -1, first_un = -1;
+        for (size_t fi = 0; fi < grid.size(); fi++) {
+            const auto& r = results[qi * grid.size() + fi];
+            if (r.coeff_f <= 0) continue;
+            if (r.cls == SvfClass::LIMIT_CYCLE && first_lc < 0) first_lc = r.coeff_f;
+            if (r.cls == SvfClass::UNSTABLE    && first_un < 0) first_un = r.coeff_f;
+            if (r.cls == SvfClass::STABLE && first_lc < 0 && first_un < 0) max_safe = r.coeff_f;
+        }
+        double fc = max_safe > 0 ? std::asin(std::min(1.0, max_safe / 65536.0)) * SAMPLE_RATE_HZ / M_PI : NAN;
+        safe << grid[qi] << "," << 4096.0 / grid[qi] << "," << max_safe << "," << fc << ","
+             << first_lc << "," << first_un << "\n";
+        if (qi % 16 == 0) {
+            std::printf("[TB] %8d %7.3f %18d %9.0f %16d %13d\n",
+                        grid[qi], 4096.0 / grid[qi], max_safe, fc, first_lc, first_un);
+        }
+    }
+    safe.close();
+
+    size_t counts[3] = {};
+    for (const auto& r : results) counts[(int)r.cls]++;
+    std::cout << "\n[TB] Stable: " << counts[0] << "  Limit cycle: " << counts[1]
+              << "  Unstable: " << counts[2] << std::endl;
+    std::cout << "[TB] " << n << " points in " << elapsed << " s" << std::endl;
+    std::cout << "[TB] Saved to " << path << " and " << safe_path << std::endl;
+    return 0;
+}
+
+//=============================================================================
+// MLS frequency response (+mls)
+//=============================================================================
+
+/**
+ * @brief Measure one filter mode with an MLS excitation on its own model.
+ *
+ * One MLS period lets the filter reach periodic steady state, the second
+ * period is recorded and cross-correlated with the excitation.
+ */
+std::vector<double> measure_mls(int mode_bits, int16_t cf, int16_t cq,
+                                const std::vector<int8_t>& seq, double amp) {
+    const std::unique_ptr<VerilatedContext> ctx{new VerilatedContext};
+    ctx->traceEverOn(false);
+    const std::unique_ptr<Vtb_svf> top{new Vtb_svf{ctx.get(), "TOP"}};
+
+    top->clk_i      = 0;
+    top->start_i    = 0;
+    top->rst_ni     = 0;
+    top->coeff_f_i  = cf;
+    top->coeff_q_i  = cq;
+    top->filt_sel_i = mode_bits;
+    for (int i = 0; i < 5; i++) tick(ctx, top);
+    top->rst_ni = 1;
+    for (int i = 0; i < 5; i++) tick(ctx, top);
+
+    size_t L = seq.size();
+    std::vector<double> y(L);
+    for (size_t n = 0; n < 2 * L; n++) {
+        int16_t in = (int16_t)(amp * seq[n % L]);
+        top->wave_i = in & 0x3FFF;
+        run_sample(ctx, top);
+        if (n >= L) y[n - L] = (int16_t)(top->wave_o << 2) >> 2;
+    }
+
+    top->final();
+    return mls_impulse_response(seq, y, amp);
+}
+
+int run_mls(int argc, char** argv, double fc, double q) {
+    int    order = (int)get_plusarg_int(argc, argv, "mls_order", 12);
+    double amp   = (double)get_plusarg_int(argc, argv, "mls_amp", 2048);
+
+    std::vector<int8_t> seq = mls_sequence(order);
+    if (seq.empty()) {
+        std::cerr << "[TB] Error: +mls_order must be 10..18" << std::endl;
+        return 1;
+    }
+
+    std::cout << "[TB] SVF MLS Frequency Response" << std::endl;
+    std::cout << "[TB] Cutoff: " << fc << " Hz, Q: " << q << std::endl;
+    std::cout << "[TB] MLS order " << order << " (" << seq.size() << " samples/period), amplitude "
+              << amp << ", " << 2 * seq.size() << " samples per mode" << std::endl;
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::vector<double>> h(4);
+    parallel_for(4, std::min(4u, sim_threads(argc, argv)), [&](size_t k, unsigned) {
+        h[k] = measure_mls(MODE_SEL[k], get_coeff_f(fc), get_coeff_q(q), seq, amp);
+    });
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    for (int k = 0; k < 4; k++) {
+        size_t nfft = next_pow2(h[k].size());
+        std::vector<std::complex<double>> spec(nfft, 0.0);
+        for (size_t i = 0; i < h[k].size(); i++) spec[i] = h[k][i];
+        fft(spec);
+
+        TableWriter<double, double, double> out;
+        if (!out.open(std::string("tmp/svf_resp_") + MODE_NAME[k], {"freq_hz", "gain_db", "phase_deg"},
+                      has_plusarg(argc, argv, "csv"))) {
+            std::cerr << "[TB] Error: Could not open " << out.filename() << std::endl;
+            return 1;
+        }
+
+        double cutoff = NAN;
+        for (size_t i = 1; i <= nfft / 2; i++) {
+            double freq  = (double)i * SAMPLE_RATE_HZ / nfft;
+            double gain  = 20.0 * std::log10(std::max(std::abs(spec[i]), 1e-9));
+            double phase = std::arg(spec[i]) * 180.0 / M_PI;
+            out.row(freq, gain, phase);
+            if (k == 0 && std::isnan(cutoff) && gain < -3.0) cutoff = freq;
+        }
+        out.close();
+        std::cout << "[TB] Saved to " << out.filename() << std::endl;
+        if (k == 0) std::cout << "[TB] Lowpass -3 dB point: ~" << cutoff << " Hz" << std::endl;
+    }
+
+    std::cout << "[TB] Measured 4 modes in " << elapsed << " s" << std::endl;
+    return 0;
+}
+
 int main(int argc, char** argv) {
     Verilated::mkdir("logs");
     const std::unique_ptr<VerilatedContext> contextp{new VerilatedContext};
     contextp->commandArgs(argc, argv);
-    contextp->traceEverOn(false);
+    contextp->traceEverOn(has_plusarg(argc, argv, "trace"));
     const std::unique_ptr<Vtb_svf> top{new Vtb_svf{contextp.get(), "TOP"}};
 
+    if (has_plusarg(argc, argv, "explore")) {
+        top->final();
+        return run_explore(argc, argv);
+    }
+
     // Filter parameters
     double fc = 1000.0;
     double q  = 0.707;
 
+    if (has_plusarg(argc, argv, "mls")) {
+        top->final();
+        return run_mls(argc, argv, fc, q);
+    }
+
     // Initial pin state
     top->clk_i     = 0;
     top->start_i   = 0;
@@ -60,11 +465,13 @@ int main(int argc, char** argv) {
     double end_freq     = 20000.0;
     double amplitude    = 8191.0;
 
+    const bool csv = has_plusarg(argc, argv, "csv");
+
     std::vector<FilterMode> test_modes = {
-        {"Lowpass",    0b001, "tmp/svf_out_lp.csv"},
-        {"Bandpass",   0b010, "tmp/svf_out_bp.csv"},
-        {"Highpass",   0b100, "tmp/svf_out_hp.csv"},
-        {"Bandreject", 0b101, "tmp/svf_out_br.csv"}
+        {"Lowpass",    0b001, "tmp/svf_out_lp"},
+        {"Bandpass",   0b010, "tmp/svf_out_bp"},
+        {"Highpass",   0b100, "tmp/svf_out_hp"},
+        {"Bandreject", 0b101, "tmp/svf_out_br"}
     };
 
     std::cout << "[TB] SVF Filter Testbench" << std::endl;
@@ -75,12 +482,11 @@ int main(int argc, char** argv) {
     for (const auto& mode : test_modes) {
         std::cout << "\n[TB] Executing " << mode.name << " sweep..." << std::endl;
 
-        std::ofstream output_file(mode.filename);
-        if (!output_file.is_open()) {
-            std::cerr << "[TB] Error: Could not open " << mode.filename << std::endl;
+        TableWriter<double, int16_t, int16_t, double> output_file;
+        if (!output_file.open(mode.filename, {"time_sec", "in_val", "out_val", "freq_hz"}, csv)) {
+            std::cerr << "[TB] Error: Could not open " << output_file.filename() << std::endl;
             return 1;
         }
-        output_file << "time_sec,in_val,out_val,freq_hz\n";
 
         // Reset
         top->rst_ni     = 0;
@@ -107,15 +513,16 @@ int main(int argc, char** argv) {
 
             int16_t out_val = (int16_t)(top->wave_o << 2) >> 2;
 
-            output_file << t_sec << "," << svf_input << "," << out_val << "," << current_freq << "\n";
+            output_file.row(t_sec, svf_input, out_val, current_freq);
         }
 
         output_file.close();
-        std::cout << "[TB] Saved to " << mode.filename << std::endl;
+        std::cout << "[TB] Saved to " << output_file.filename() << std::endl;
     }
 
     top->final();
 
     std::cout << "\n[TB] All simulations finished." << std::endl;
+    report_stats(argc, argv, contextp, "svf");
     return 0;
 }
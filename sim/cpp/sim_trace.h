@@ -0,0 +1,1482 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  File: sim_trace.h
+//  Description: Instrumentation fed from the probe ports of the top-level
+//               testbench wrappers: a Chrome/Perfetto trace-event timeline of
+//               the TT6581 FSMs, shared-multiplier usage counters, a
+//               controller cycle budget, an overflow/saturation monitor
+//               for the mix path, a per-sample signal logger, a register
+//               write log and windowed/triggered FST waveform dumps, and
+//               the set of all of them that the tt6581 modes hold.
+//
+//  Author:
+//    - Andreas Pedersen
+//
+//-------------------------------------------------------------------------------------------------
+
+#ifndef SIM_TRACE_H
+#define SIM_TRACE_H
+
+#include "sim_common.h"
+#include "sim_model.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#if VM_TRACE_FST
+#include <verilated_fst_c.h>
+#endif
+
+//=============================================================================
+// FSM State Names
+//=============================================================================
+
+// controller.sv state_e
+enum CtrlState {
+    CTRL_IDLE, CTRL_SYN, CTRL_SYN_WAIT, CTRL_ENV, CTRL_ENV_WAIT, CTRL_ACCUM,
+    CTRL_FILT, CTRL_FILT_WAIT, CTRL_VOL, CTRL_VOL_WAIT, CTRL_DONE
+};
+
+inline const char* const CTRL_STATE_NAME[] = {
+    "IDLE", "SYN", "SYN_WAIT", "ENV", "ENV_WAIT", "ACCUM",
+    "FILT", "FILT_WAIT", "VOL", "VOL_WAIT", "DONE"
+};
+
+// envelope.sv state_e
+inline const char* const ENV_STATE_NAME[] = {"IDLE", "ADSR", "MULT", "DONE"};
+
+// svf.sv state_e
+enum SvfState {
+    SVF_IDLE, SVF_MULT_Q, SVF_WAIT_Q, SVF_CALC_HP, SVF_MULT_F1, SVF_WAIT_F1,
+    SVF_CALC_BP, SVF_MULT_F2, SVF_WAIT_F2, SVF_CALC_LP, SVF_DONE
+};
+
+inline const char* const SVF_STATE_NAME[] = {
+    "IDLE", "MULT_Q", "WAIT_Q", "CALC_HP", "MULT_F1", "WAIT_F1",
+    "CALC_BP", "MULT_F2", "WAIT_F2", "CALC_LP", "DONE"
+};
+
+// tt6581.sv mult_in_mux
+inline const char* const MULT_MUX_NAME[] = {"voice x env", "svf", "volume", "?"};
+
+//=============================================================================
+// Timeline
+//=============================================================================
+
+/**
+ * @brief Trace-event JSON sink for one time window of a top-level harness.
+ *
+ * sample() is called once per system clock and only compares the probe
+ * ports with their previous values, so the cost outside the window is one
+ * branch. Each FSM activation becomes a complete ("X") event; per-state
+ * spans are nested inside when detail is enabled. Open the output in
+ * ui.perfetto.dev or chrome://tracing.
+ *
+ * Tracks:
+ *   controller  sample > voice N / filter / volume > state
+ *   envelope    env vN > state
+ *   svf         svf > state
+ *   mult        one span per product, named by requester
+ *   spi         one span per chip-select frame, with the register write
+ *
+ * @tparam Top  Verilated wrapper with the tb_tt6581 probe ports.
+ */
+template <typename Top>
+class Timeline {
+public:
+    static constexpr size_t BUF_BYTES    = 1 << 20;
+    static constexpr double US_PER_CYCLE = CLK_PERIOD_NS / 1000.0;
+
+    ~Timeline() { close(); }
+
+    /**
+     * @brief Enable the timeline from plusargs.
+     *
+     * +timeline[=path]      Enable, default path tmp/timeline.json
+     * +timeline_start=sec   Window start (default 0)
+     * +timeline_len=sec     Window length (default 0.1)
+     * +timeline_detail=0    Only module activations, no per-state spans
+     *
+     * @return  true if the timeline was enabled.
+     */
+    bool open(int argc, char** argv) {
+        if (!has_plusarg(argc, argv, "timeline")) return false;
+
+        std::string path = get_plusarg(argc, argv, "timeline", "tmp/timeline.json");
+        double start_sec = std::stod(get_plusarg(argc, argv, "timeline_start", "0"));
+        double len_sec   = std::stod(get_plusarg(argc, argv, "timeline_len", "0.1"));
+        detail = get_plusarg_int(argc, argv, "timeline_detail", 1) != 0;
+
+        file.open(path);
+        if (!file) {
+            std::cerr << "[TB] Error: Could not open " << path << std::endl;
+            return false;
+        }
+
+        win_start = (uint64_t)(start_sec * CLK_FREQ_HZ);
+        win_end   = win_start + (uint64_t)(len_sec * CLK_FREQ_HZ);
+        buf.reserve(BUF_BYTES + 256);
+
+        buf += "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+        buf += "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"TT6581\"}}";
+        const char* tracks[] = {"controller", "envelope", "svf", "mult", "spi"};
+        for (int t = 0; t < 5; t++) {
+            char ev[160];
+            std::snprintf(ev, sizeof(ev),
+                          ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}"
+                          ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":%d}}",
+                          t + 1, tracks[t], t + 1, t);
+            buf += ev;
+        }
+
+        std::cout << "[TB] Timeline: " << start_sec << " s + " << len_sec << " s to " << path << std::endl;
+        active = true;
+        return true;
+    }
+
+    /**
+     * @brief Record FSM transitions for one system clock.
+     *
+     * @param top    Model, sampled after the clock edge.
+     * @param cycle  Current system clock cycle.
+     */
+    void sample(const Top& top, uint64_t cycle) {
+        if (!active || cycle < win_start) return;
+        if (cycle >= win_end) {
+            close();
+            return;
+        }
+
+        if (!started) {
+            // Only spans that begin inside the window are recorded
+            ctrl    = top.ctrl_state_o;
+            env     = top.env_state_o;
+            svf     = top.svf_state_o;
+            mult    = top.mult_busy_o;
+            spi     = top.spi_active_o;
+            ctrl_on = env_on = svf_on = mult_on = spi_on = false;
+            started = true;
+            return;
+        }
+
+        if (top.ctrl_state_o != ctrl) step_ctrl(top, cycle);
+        if (top.env_state_o != env)   step_env(top, cycle);
+        if (top.svf_state_o != svf)   step_svf(cycle, top.svf_state_o);
+
+        if (top.mult_busy_o != mult) {
+            mult = top.mult_busy_o;
+            if (mult) {
+                mult_since = cycle;
+                mult_mux   = top.mult_mux_o & 3;
+                mult_on    = true;
+            } else if (mult_on) {
+                span(TID_MULT, MULT_MUX_NAME[mult_mux], mult_since, cycle);
+            }
+        }
+
+        if (top.spi_active_o != spi) {
+            spi = top.spi_active_o;
+            if (spi) {
+                spi_since = cycle;
+                spi_write = false;
+                spi_on    = true;
+            } else if (spi_on) {
+                if (spi_write) {
+                    char name[32], args[48];
+                    std::snprintf(name, sizeof(name), "write 0x%02X", spi_addr);
+                    std::snprintf(args, sizeof(args), "{\"data\":\"0x%02X\"}", spi_data);
+                    span(TID_SPI, name, spi_since, cycle, args);
+                } else {
+                    span(TID_SPI, "frame", spi_since, cycle);
+                }
+            }
+        }
+        if (top.reg_we_o) {
+            spi_write = true;
+            spi_addr  = top.reg_addr_o;
+            spi_data  = top.reg_wdata_o;
+        }
+    }
+
+    /**
+     * @brief Terminate the JSON and close the file. Safe to call twice.
+     */
+    void close() {
+        if (!active) return;
+        buf += "\n]}\n";
+        flush();
+        file.close();
+        active = false;
+        std::cout << "[TB] Timeline: wrote " << events << " events" << std::endl;
+    }
+
+private:
+    enum Track { TID_CTRL = 1, TID_ENV, TID_SVF, TID_MULT, TID_SPI };
+
+    void step_ctrl(const Top& top, uint64_t cycle) {
+        int old = ctrl;
+        int now = top.ctrl_state_o;
+        ctrl = now;
+
+        if (!ctrl_on) {
+            // Wait for the first sample that starts inside the window
+            if (old != CTRL_IDLE || now == CTRL_IDLE) return;
+            ctrl_on = true;
+        }
+
+        if (detail && old != CTRL_IDLE) span(TID_CTRL, CTRL_STATE_NAME[old], ctrl_since, cycle);
+        ctrl_since = cycle;
+
+        // Close spans before opening new ones: ACCUM -> SYN ends one voice
+        // and starts the next
+        if (old == CTRL_ACCUM) {
+            char name[16];
+            std::snprintf(name, sizeof(name), "voice %d", voice);
+            span(TID_CTRL, name, voice_since, cycle);
+        }
+        if (old == CTRL_FILT_WAIT) span(TID_CTRL, "filter", filt_since, cycle);
+        if (old == CTRL_VOL_WAIT)  span(TID_CTRL, "volume", vol_since, cycle);
+        if (now == CTRL_IDLE)      span(TID_CTRL, "sample", sample_since, cycle);
+
+        if (old == CTRL_IDLE)      sample_since = cycle;
+        if (now == CTRL_SYN)       { voice_since = cycle; voice = top.ctrl_voice_o; }
+        if (now == CTRL_FILT)      filt_since = cycle;
+        if (now == CTRL_VOL)       vol_since = cycle;
+    }
+
+    void step_env(const Top& top, uint64_t cycle) {
+        int old = env;
+        int now = top.env_state_o;
+        env = now;
+
+        if (!env_on) {
+            if (old != 0 || now == 0) return;
+            env_on = true;
+        }
+
+        if (detail && old != 0) span(TID_ENV, ENV_STATE_NAME[old], env_state_since, cycle);
+        env_state_since = cycle;
+
+        if (old == 0) {
+            env_since = cycle;
+            env_voice = top.ctrl_voice_o;
+        }
+        if (now == 0) {
+            char name[16];
+            std::snprintf(name, sizeof(name), "env v%d", env_voice);
+            span(TID_ENV, name, env_since, cycle);
+        }
+    }
+
+    void step_svf(uint64_t cycle, int now) {
+        int old = svf;
+        svf = now;
+
+        if (!svf_on) {
+            if (old != 0 || now == 0) return;
+            svf_on = true;
+        }
+
+        if (detail && old != 0) span(TID_SVF, SVF_STATE_NAME[old], svf_state_since, cycle);
+        svf_state_since = cycle;
+
+        if (old == 0) svf_since = cycle;
+        if (now == 0) span(TID_SVF, "svf", svf_since, cycle);
+    }
+
+    void span(int tid, const char* name, uint64_t begin, uint64_t end, const char* args = nullptr) {
+        char ev[192];
+        std::snprintf(ev, sizeof(ev),
+                      ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.2f,\"dur\":%.2f,\"name\":\"%s\"%s%s}",
+                      tid, begin * US_PER_CYCLE, (end - begin) * US_PER_CYCLE, name,
+                      args ? ",\"args\":" : "", args ? args : "");
+        buf += ev;
+        events++;
+        if (buf.size() >= BUF_BYTES) flush();
+    }
+
+    void flush() {
+        ScopedPhase phase(PHASE_IO);
+        file.write(buf.data(), buf.size());
+        buf.clear();
+    }
+
+    std::ofstream file;
+    std::string   buf;
+    bool          active    = false;
+    bool          started   = false;
+    bool          detail    = true;
+    uint64_t      win_start = 0;
+    uint64_t      win_end   = 0;
+    uint64_t      events    = 0;
+
+    // Previous probe values
+    int  ctrl = 0, env = 0, svf = 0;
+    bool mult = false, spi = false;
+
+    // Set once the FSM has started an activation inside the window
+    bool ctrl_on = false, env_on = false, svf_on = false, mult_on = false, spi_on = false;
+
+    uint64_t ctrl_since = 0, sample_since = 0, voice_since = 0, filt_since = 0, vol_since = 0;
+    uint64_t env_since = 0, env_state_since = 0;
+    uint64_t svf_since = 0, svf_state_since = 0;
+    uint64_t mult_since = 0, spi_since = 0;
+    int      voice = 0, env_voice = 0, mult_mux = 0;
+    bool     spi_write = false;
+    uint8_t  spi_addr = 0, spi_data = 0;
+};
+
+//=============================================================================
+// Multiplier Usage
+//=============================================================================
+
+/**
+ * @brief Bin of a histogram below which a fraction p of its counts fall.
+ */
+inline uint64_t hist_percentile(const std::vector<uint64_t>& hist, double p) {
+    uint64_t n = 0;
+    for (uint64_t h : hist) n += h;
+    uint64_t acc = 0;
+    for (size_t i = 0; i < hist.size(); i++) {
+        acc += hist[i];
+        if (acc >= p * n) return i;
+    }
+    return hist.size() - 1;
+}
+
+/**
+ * @brief Utilization and contention counters for the shared multiplier.
+ *
+ * Envelope, controller and SVF share one 17-cycle shift-add multiplier and
+ * the controller processes voices serially, so the sample latency from
+ * sample_tick to audio_valid is what limits more voices or filter stages.
+ * Per sample this records busy cycles by requester (mult_in_mux at the
+ * start of each product), idle gaps between products, the latency and the
+ * cost of each controller stage, and reports histograms over the run. The
+ * projection of what else would fit is CycleBudget's.
+ *
+ * @tparam Top  Verilated wrapper with the tb_tt6581 probe ports.
+ */
+template <typename Top>
+class MultUsage {
+public:
+    static constexpr int NUM_REQ   = 3;
+    static constexpr int HIST_BINS = CYCLES_PER_SAMPLE + 1;
+
+    /**
+     * @brief Enable the counters if +mult_usage was given.
+     */
+    bool open(int argc, char** argv) {
+        active = has_plusarg(argc, argv, "mult_usage");
+        busy_hist.assign(HIST_BINS, 0);
+        latency_hist.assign(HIST_BINS, 0);
+        gap_hist.assign(HIST_BINS, 0);
+        return active;
+    }
+
+    /**
+     * @brief Update the counters for one system clock.
+     */
+    void sample(const Top& top) {
+        if (!active) return;
+        cycle++;
+
+        if (top.sample_tick_o) {
+            end_sample();
+            tick_cycle = cycle;
+            in_sample  = true;
+            gap_cross  = true;
+        }
+
+        if (top.mult_busy_o) {
+            if (!busy) {
+                req = std::min<int>(top.mult_mux_o, NUM_REQ - 1);
+                cur.products[req]++;
+                // Gaps that span a sample tick are the idle tail, not contention
+                if (gap_open && !gap_cross) gap_hist[std::min<uint64_t>(cycle - gap_start, HIST_BINS - 1)]++;
+            }
+            cur.busy[req]++;
+        } else if (busy) {
+            gap_start = cycle;
+            gap_open  = true;
+            gap_cross = false;
+        }
+        busy = top.mult_busy_o;
+
+        if (top.audio_valid_o && in_sample) {
+            uint64_t lat = cycle - tick_cycle;
+            latency_hist[std::min<uint64_t>(lat, HIST_BINS - 1)]++;
+            latency_max = std::max(latency_max, lat);
+        }
+
+        int state = top.ctrl_state_o;
+        if (state != ctrl) {
+            // ACCUM -> SYN ends one voice stage and starts the next
+            if (ctrl == CTRL_ACCUM)      end_stage(0);
+            if (ctrl == CTRL_FILT_WAIT)  end_stage(1);
+            if (ctrl == CTRL_VOL_WAIT)   end_stage(2);
+            if (state == CTRL_SYN)       stage_since[0] = cycle;
+            if (state == CTRL_FILT)      stage_since[1] = cycle;
+            if (state == CTRL_VOL)       stage_since[2] = cycle;
+            ctrl = state;
+        }
+    }
+
+    /**
+     * @brief Print the summary and write the histograms to tmp/mult_usage.csv.
+     *
+     * @return  false if the CSV could not be opened.
+     */
+    bool report() {
+        if (!active) return true;
+        end_sample();
+        active = false;
+        if (samples == 0) return true;
+
+        static const char* const REQ_NAME[NUM_REQ] = {"voice x env", "svf", "volume"};
+        static const char* const STAGE_NAME[3]     = {"voice", "filter", "volume"};
+
+        uint64_t busy_sum = 0;
+        for (int r = 0; r < NUM_REQ; r++) busy_sum += total.busy[r];
+
+        std::printf("[TB] Multiplier usage over %llu samples (%d cycles each)\n",
+                    (unsigned long long)samples, (int)CYCLES_PER_SAMPLE);
+        std::printf("[TB]   busy per sample: mean %.1f, p99 %llu, max %llu cycles (%.1f %% / %.1f %%)\n",
+                    (double)busy_sum / samples, (unsigned long long)hist_percentile(busy_hist, 0.99),
+                    (unsigned long long)busy_max, 100.0 * busy_sum / samples / CYCLES_PER_SAMPLE,
+                    100.0 * busy_max / CYCLES_PER_SAMPLE);
+        for (int r = 0; r < NUM_REQ; r++) {
+            std::printf("[TB]     %-12s %7.1f cycles, %.2f products per sample\n", REQ_NAME[r],
+                        (double)total.busy[r] / samples, (double)total.products[r] / samples);
+        }
+
+        uint64_t gaps = 0, gap_sum = 0, gap_max = 0;
+        for (int i = 0; i < HIST_BINS; i++) {
+            gaps    += gap_hist[i];
+            gap_sum += gap_hist[i] * i;
+            if (gap_hist[i]) gap_max = i;
+        }
+        std::printf("[TB]   idle gaps within a sample: %.2f per sample, mean %.1f, max %llu cycles\n",
+                    (double)gaps / samples, gaps ? (double)gap_sum / gaps : 0.0, (unsigned long long)gap_max);
+
+        uint64_t lat_n = 0, lat_sum = 0;
+        for (int i = 0; i < HIST_BINS; i++) {
+            lat_n   += latency_hist[i];
+            lat_sum += latency_hist[i] * i;
+        }
+        std::printf("[TB]   sample latency (sample_tick -> audio_valid): mean %.1f, p99 %llu, max %llu cycles\n",
+                    lat_n ? (double)lat_sum / lat_n : 0.0, (unsigned long long)hist_percentile(latency_hist, 0.99),
+                    (unsigned long long)latency_max);
+
+        for (int s = 0; s < 3; s++) {
+            std::printf("[TB]   %-6s stage: mean %.1f, max %llu cycles\n", STAGE_NAME[s],
+                        stage_n[s] ? (double)stage_sum[s] / stage_n[s] : 0.0,
+                        (unsigned long long)stage_max[s]);
+        }
+
+        std::ofstream csv("tmp/mult_usage.csv");
+        if (!csv.is_open()) {
+            std::cerr << "[TB] Error: Could not open tmp/mult_usage.csv" << std::endl;
+            return false;
+        }
+        csv << "cycles,busy_samples,latency_samples,idle_gaps\n";
+        for (int i = 0; i < HIST_BINS; i++) {
+            csv << i << "," << busy_hist[i] << "," << latency_hist[i] << "," << gap_hist[i] << "\n";
+        }
+        std::cout << "[TB] Saved to tmp/mult_usage.csv" << std::endl;
+        return true;
+    }
+
+private:
+    struct Counts {
+        uint64_t busy[NUM_REQ]     = {};
+        uint64_t products[NUM_REQ] = {};
+    };
+
+    void end_sample() {
+        if (!in_sample) {
+            cur = Counts();
+            return;
+        }
+        uint64_t b = 0;
+        for (int r = 0; r < NUM_REQ; r++) {
+            b += cur.busy[r];
+            total.busy[r]     += cur.busy[r];
+            total.products[r] += cur.products[r];
+        }
+        busy_hist[std::min<uint64_t>(b, HIST_BINS - 1)]++;
+        busy_max = std::max(busy_max, b);
+        samples++;
+        cur = Counts();
+    }
+
+    void end_stage(int s) {
+        uint64_t d = cycle - stage_since[s];
+        stage_sum[s] += d;
+        stage_max[s]  = std::max(stage_max[s], d);
+        stage_n[s]++;
+    }
+
+    bool     active      = false;
+    bool     in_sample   = false;
+    bool     busy        = false;
+    bool     gap_open    = false;
+    bool     gap_cross   = false;
+    int      req         = 0;
+    int      ctrl        = CTRL_IDLE;
+    uint64_t cycle       = 0;
+    uint64_t tick_cycle  = 0;
+    uint64_t gap_start   = 0;
+    uint64_t samples     = 0;
+    uint64_t busy_max    = 0;
+    uint64_t latency_max = 0;
+
+    Counts   cur, total;
+    uint64_t stage_since[3] = {}, stage_sum[3] = {}, stage_max[3] = {}, stage_n[3] = {};
+
+    std::vector<uint64_t> busy_hist, latency_hist, gap_hist;
+};
+
+//=============================================================================
+// Controller Cycle Budget
+//=============================================================================
+
+/**
+ * @brief Clocks per controller state per sample, and what else would fit.
+ *
+ * Every clock is charged to the controller state and voice (ctrl_state_o,
+ * ctrl_voice_o) of the sample it belongs to; a sample runs from one
+ * sample_tick to the next. The controller only sees a tick in IDLE, so a
+ * sample may use at most CYCLES_PER_SAMPLE - 1 non-IDLE clocks. The report
+ * gives mean and worst clocks per state and stage, the worst sample, and
+ * projects from the worst stage costs how many voices or filter stages, or
+ * how high a sample rate, would still fit.
+ *
+ * @tparam Top  Verilated wrapper with the tb_tt6581 probe ports.
+ */
+template <typename Top>
+class CycleBudget {
+public:
+    static constexpr int NUM_STATES = CTRL_DONE + 1;
+    static constexpr int NUM_VOICES = 3;
+    static constexpr int HIST_BINS  = CYCLES_PER_SAMPLE + 1;
+
+    /**
+     * @brief Enable the counters if +cycle_budget was given.
+     */
+    bool open(int argc, char** argv) {
+        active = has_plusarg(argc, argv, "cycle_budget");
+        busy_hist.assign(HIST_BINS, 0);
+        return active;
+    }
+
+    /**
+     * @brief Charge one system clock.
+     */
+    void sample(const Top& top) {
+        if (!active) return;
+        if (top.sample_tick_o) {
+            if (top.ctrl_state_o != CTRL_IDLE) overruns++;
+            end_sample();
+            in_sample    = true;
+            sample_start = cycle;
+        }
+        cur[std::min<int>(top.ctrl_state_o, NUM_STATES - 1)][top.ctrl_voice_o]++;
+        cycle++;
+    }
+
+    /**
+     * @brief Print the budget and projection, and write tmp/cycle_budget.csv.
+     *
+     * @return  false if the CSV could not be opened.
+     */
+    bool report() {
+        if (!active) return true;
+        active = false;
+        if (samples == 0) return true;
+
+        static const char* const STAGE_NAME[NUM_STAGES] = {"voice", "filter", "volume", "done"};
+
+        std::printf("[TB] Controller cycle budget over %llu samples (%d cycles each)\n",
+                    (unsigned long long)samples, (int)CYCLES_PER_SAMPLE);
+        std::printf("[TB]   %-10s %15s %15s %15s %15s\n", "state", "voice 0", "voice 1", "voice 2", "per sample");
+        for (int s = CTRL_SYN; s < NUM_STATES; s++) {
+            std::printf("[TB]   %-10s", CTRL_STATE_NAME[s]);
+            for (int v = 0; v < NUM_VOICES; v++) {
+                if (s <= CTRL_ACCUM) std::printf(" %7.2f / %5llu", mean(state_v[s][v]), (unsigned long long)state_v[s][v].max);
+                else                 std::printf(" %15s", "");
+            }
+            std::printf(" %7.2f / %5llu\n", mean(state[s]), (unsigned long long)state[s].max);
+        }
+        std::printf("[TB]   (mean / max clocks)\n");
+
+        for (int g = 0; g < NUM_STAGES; g++) {
+            std::printf("[TB]   %-6s stage: mean %.2f, max %llu cycles%s\n", STAGE_NAME[g], mean(stage[g]),
+                        (unsigned long long)stage[g].max, g == 0 ? " per voice" : "");
+        }
+        std::printf("[TB]   busy per sample: mean %.2f, p99 %llu, max %llu cycles "
+                    "(worst sample at %.6f s), %llu overruns\n",
+                    mean(busy), (unsigned long long)hist_percentile(busy_hist, 0.99),
+                    (unsigned long long)busy.max, (double)worst_start / CLK_FREQ_HZ,
+                    (unsigned long long)overruns);
+
+        // Projection from the worst cost of each stage
+        const uint64_t voice  = stage[0].max, filter = stage[1].max;
+        const uint64_t fixed  = stage[2].max + stage[3].max;
+        const uint64_t usable = CYCLES_PER_SAMPLE - 1;
+        auto cost = [&](uint64_t voices, uint64_t filters) { return voices * voice + filters * filter + fixed; };
+
+        const uint64_t now = cost(NUM_VOICES, 1);
+        std::printf("[TB]   projection (worst stage costs, %llu usable cycles):\n", (unsigned long long)usable);
+        std::printf("[TB]     %d voices + 1 filter stage: %llu cycles, %llu spare\n", NUM_VOICES,
+                    (unsigned long long)now, (unsigned long long)(now < usable ? usable - now : 0));
+        if (voice && now <= usable) {
+            std::printf("[TB]     voices with 1 filter stage: up to %llu\n",
+                        (unsigned long long)((usable - filter - fixed) / voice));
+        }
+        if (filter && now <= usable) {
+            std::printf("[TB]     filter stages with %d voices: up to %llu\n", NUM_VOICES,
+                        (unsigned long long)((usable - NUM_VOICES * voice - fixed) / filter));
+        }
+        std::printf("[TB]     sample rate with %d voices: up to %.1f kHz (%llu cycles per sample)\n",
+                    NUM_VOICES, CLK_FREQ_HZ / 1e3 / (now + 1), (unsigned long long)(now + 1));
+        std::printf("[TB]     %6s %8s %14s\n", "voices", "cycles", "max rate kHz");
+        for (uint64_t n = 1; n <= 16; n++) {
+            const uint64_t c = cost(n, 1);
+            std::printf("[TB]     %6llu %8llu %14.1f%s\n", (unsigned long long)n, (unsigned long long)c,
+                        CLK_FREQ_HZ / 1e3 / (c + 1), n == NUM_VOICES ? "  (now)" : "");
+        }
+
+        std::ofstream csv("tmp/cycle_budget.csv");
+        if (!csv.is_open()) {
+            std::cerr << "[TB] Error: Could not open tmp/cycle_budget.csv" << std::endl;
+            return false;
+        }
+        csv << "name,voice,mean,max\n";
+        for (int s = 0; s < NUM_STATES; s++) {
+            for (int v = 0; v < NUM_VOICES && s >= CTRL_SYN && s <= CTRL_ACCUM; v++) {
+                csv << CTRL_STATE_NAME[s] << "," << v << "," << mean(state_v[s][v]) << "," << state_v[s][v].max << "\n";
+            }
+            csv << CTRL_STATE_NAME[s] << ",," << mean(state[s]) << "," << state[s].max << "\n";
+        }
+        for (int g = 0; g < NUM_STAGES; g++) {
+            csv << "stage_" << STAGE_NAME[g] << ",," << mean(stage[g]) << "," << stage[g].max << "\n";
+        }
+        csv << "busy,," << mean(busy) << "," << busy.max << "\n";
+        std::cout << "[TB] Saved to tmp/cycle_budget.csv" << std::endl;
+        return true;
+    }
+
+private:
+    static constexpr int NUM_STAGES = 4;    // Voice (per voice), filter, volume, done
+
+    struct Stat {
+        uint64_t sum = 0, n = 0, max = 0;
+        void add(uint64_t v) {
+            sum += v;
+            n++;
+            max = std::max(max, v);
+        }
+    };
+
+    static double mean(const Stat& s) { return s.n ? (double)s.sum / s.n : 0.0; }
+
+    void end_sample() {
+        if (in_sample) {
+            uint64_t b = 0;
+            for (int s = 0; s < NUM_STATES; s++) {
+                uint64_t total = 0;
+                for (int v = 0; v < 4; v++) total += cur[s][v];
+                if (s <= CTRL_ACCUM && s >= CTRL_SYN) {
+                    for (int v = 0; v < NUM_VOICES; v++) state_v[s][v].add(cur[s][v]);
+                }
+                state[s].add(total);
+                if (s != CTRL_IDLE) b += total;
+            }
+            for (int v = 0; v < NUM_VOICES; v++) {
+                uint64_t c = 0;
+                for (int s = CTRL_SYN; s <= CTRL_ACCUM; s++) c += cur[s][v];
+                stage[0].add(c);
+            }
+            uint64_t filt = 0, vol = 0;
+            for (int v = 0; v < 4; v++) {
+                filt += cur[CTRL_FILT][v] + cur[CTRL_FILT_WAIT][v];
+                vol  += cur[CTRL_VOL][v] + cur[CTRL_VOL_WAIT][v];
+            }
+            stage[1].add(filt);
+            stage[2].add(vol);
+            stage[3].add(cur[CTRL_DONE][0] + cur[CTRL_DONE][1] + cur[CTRL_DONE][2] + cur[CTRL_DONE][3]);
+
+            if (b > busy.max) worst_start = sample_start;
+            busy.add(b);
+            busy_hist[std::min<uint64_t>(b, HIST_BINS - 1)]++;
+            samples++;
+        }
+        std::memset(cur, 0, sizeof(cur));
+    }
+
+    bool     active       = false;
+    bool     in_sample    = false;
+    uint64_t cycle        = 0;
+    uint64_t sample_start = 0;
+    uint64_t worst_start  = 0;
+    uint64_t samples      = 0;
+    uint64_t overruns     = 0;  // Ticks that found the controller busy
+
+    uint64_t cur[NUM_STATES][4] = {};   // Clocks of the current sample per state and ctrl_voice_o
+    Stat     state[NUM_STATES];
+    Stat     state_v[NUM_STATES][NUM_VOICES];
+    Stat     stage[NUM_STAGES];
+    Stat     busy;
+
+    std::vector<uint64_t> busy_hist;
+};
+
+//=============================================================================
+// Overflow Monitor
+//=============================================================================
+
+enum OverflowStage {
+    OVF_BYPASS_ACCUM, OVF_FILTER_ACCUM, OVF_SVF_HP, OVF_SVF_BP, OVF_SVF_LP,
+    OVF_SVF_SAT, OVF_MIX_SUM, NUM_OVF_STAGES
+};
+
+inline const char* const OVF_STAGE_NAME[NUM_OVF_STAGES] = {
+    "bypass_accum", "filter_accum", "svf hp_node", "svf reg_band", "svf reg_low",
+    "svf saturate", "svf_bypass_sum"
+};
+
+/**
+ * @brief Wraparound and saturation monitor for the mix path.
+ *
+ * Recomputes each register update of the mix path at full precision from
+ * the probe ports and flags results outside the register width:
+ *   bypass_accum / filter_accum  14-bit sums of voice x envelope (per voice)
+ *   svf hp_node/reg_band/reg_low 24-bit SVF state updates
+ *   svf saturate                 SVF output clamped to +/-8191
+ *   svf_bypass_sum               14-bit sum of SVF output and bypass voices
+ *
+ * Checks only run on the cycles that update the register, but the monitor
+ * still reads the probes every clock, so it is off unless asked for.
+ *
+ * @tparam Top  Verilated wrapper with the tb_tt6581 probe ports.
+ */
+template <typename Top>
+class OverflowMonitor {
+public:
+    /**
+     * @brief Enable the monitor from plusargs.
+     *
+     * +overflow         Enable
+     * +overflow_log=N   Enable, log the first N events (default 10)
+     * +overflow_fail    Enable, exit non-zero if any event occurred
+     *
+     * +trace_on=overflow also enables it, as the trigger source.
+     */
+    bool open(int argc, char** argv) {
+        log_limit = get_plusarg_int(argc, argv, "overflow_log", 10);
+        fail      = has_plusarg(argc, argv, "overflow_fail");
+        active    = fail || has_plusarg(argc, argv, "overflow") || has_plusarg(argc, argv, "overflow_log") ||
+                    get_plusarg(argc, argv, "trace_on").find("overflow") != std::string::npos;
+        return active;
+    }
+
+    /**
+     * @brief Check the register updates of one system clock.
+     */
+    void sample(const Top& top) {
+        if (!active) return;
+        if (top.sample_tick_o) samples++;
+
+        if (top.accum_en_o) {
+            // cur_voice has already advanced past the voice being accumulated
+            int     voice = (top.ctrl_voice_o - 1) & 3;
+            bool    filt  = top.accum_mux_o;
+            int32_t acc   = wrap_signed<14>(filt ? top.filter_accum_o : top.bypass_accum_o);
+            int32_t add   = wrap_signed<14>(top.mult_out_o);
+            check(filt ? OVF_FILTER_ACCUM : OVF_BYPASS_ACCUM, voice, (int64_t)acc + add, 14, acc, add);
+        }
+
+        int svf = top.svf_state_o;
+        if (svf != svf_prev) {
+            int64_t prod = wrap_signed<40>((int64_t)top.mult_prod_o);
+            int32_t band = wrap_signed<24>(top.svf_band_o);
+            int32_t low  = wrap_signed<24>(top.svf_low_o);
+            switch (svf) {
+                case SVF_CALC_HP: {
+                    int32_t in = wrap_signed<14>(top.filter_accum_o);
+                    int32_t q  = wrap_signed<24>(prod >> 12);
+                    check(OVF_SVF_HP, -1, (int64_t)in - low - q, 24, in - low, -q);
+                    break;
+                }
+                case SVF_CALC_BP: {
+                    int32_t f = wrap_signed<24>(prod >> 15);
+                    check(OVF_SVF_BP, -1, (int64_t)band + f, 24, band, f);
+                    break;
+                }
+                case SVF_CALC_LP: {
+                    int32_t f = wrap_signed<24>(prod >> 15);
+                    check(OVF_SVF_LP, -1, (int64_t)low + f, 24, low, f);
+                    break;
+                }
+                case SVF_DONE: {
+                    int32_t sel = wrap_signed<24>(top.svf_sel_o);
+                    if (sel > 8191 || sel < -8192) record(OVF_SVF_SAT, -1, sel, "clipped to 14 bits");
+                    break;
+                }
+                default: break;
+            }
+            svf_prev = svf;
+        }
+
+        int ctrl = top.ctrl_state_o;
+        if (ctrl != ctrl_prev) {
+            // Volume multiply operand: svf_out + bypass_accum
+            if (ctrl == CTRL_VOL) {
+                int32_t a = wrap_signed<14>(top.svf_out_o);
+                int32_t b = wrap_signed<14>(top.bypass_accum_o);
+                check(OVF_MIX_SUM, -1, (int64_t)a + b, 14, a, b);
+            }
+            ctrl_prev = ctrl;
+        }
+    }
+
+    uint64_t total() const { return events; }
+
+    /**
+     * @brief Print the per-stage counts.
+     */
+    void report() const {
+        if (!active) return;
+        if (events == 0) {
+            std::printf("[TB] Overflow monitor: no wraparound or saturation in %llu samples\n",
+                        (unsigned long long)samples);
+            return;
+        }
+        std::printf("[TB] Overflow monitor: %llu events in %llu of %llu samples\n",
+                    (unsigned long long)events, (unsigned long long)bad_samples,
+                    (unsigned long long)samples);
+        std::printf("[TB]   %-16s %9s %9s %9s %9s\n", "stage", "voice 0", "voice 1", "voice 2", "total");
+        for (int s = 0; s < NUM_OVF_STAGES; s++) {
+            uint64_t sum = counts[s][0] + counts[s][1] + counts[s][2] + counts[s][3];
+            if (sum == 0) continue;
+            if (s == OVF_BYPASS_ACCUM || s == OVF_FILTER_ACCUM) {
+                std::printf("[TB]   %-16s %9llu %9llu %9llu %9llu\n", OVF_STAGE_NAME[s],
+                            (unsigned long long)counts[s][0], (unsigned long long)counts[s][1],
+                            (unsigned long long)counts[s][2], (unsigned long long)sum);
+            } else {
+                std::printf("[TB]   %-16s %9s %9s %9s %9llu\n", OVF_STAGE_NAME[s], "-", "-", "-",
+                            (unsigned long long)sum);
+            }
+        }
+    }
+
+    /**
+     * @brief Exit code for the harness: 1 with +overflow_fail and any event.
+     */
+    int exit_code() const { return (fail && events) ? 1 : 0; }
+
+private:
+    void check(int stage, int voice, int64_t exact, int bits, int64_t a, int64_t b) {
+        int64_t max = (1LL << (bits - 1)) - 1;
+        if (exact <= max && exact >= -max - 1) return;
+
+        char detail[96];
+        std::snprintf(detail, sizeof(detail), "%lld + %lld = %lld wraps to %lld (%d-bit)",
+                      (long long)a, (long long)b, (long long)exact,
+                      (long long)((int64_t)((uint64_t)exact << (64 - bits)) >> (64 - bits)), bits);
+        record(stage, voice, exact, detail);
+    }
+
+    void record(int stage, int voice, int64_t value, const char* detail) {
+        counts[stage][voice < 0 ? 3 : voice]++;
+        events++;
+        if (samples != last_sample) {
+            bad_samples++;
+            last_sample = samples;
+        }
+        if (logged < log_limit) {
+            uint64_t index = samples ? samples - 1 : 0;
+            logged++;
+            std::printf("[TB] Overflow at %.6f s (sample %llu): %s", (double)index / SAMPLE_RATE_HZ,
+                        (unsigned long long)index, OVF_STAGE_NAME[stage]);
+            if (voice >= 0) std::printf(" voice %d", voice);
+            if (stage == OVF_SVF_SAT) std::printf(": %lld %s\n", (long long)value, detail);
+            else                      std::printf(": %s\n", detail);
+            if (logged == log_limit) std::printf("[TB] Overflow: further events are counted only\n");
+        }
+    }
+
+    long     log_limit   = 10;
+    long     logged      = 0;
+    bool     active      = false;
+    bool     fail        = false;
+    int      svf_prev    = SVF_IDLE;
+    int      ctrl_prev   = CTRL_IDLE;
+    uint64_t samples     = 0;
+    uint64_t events      = 0;
+    uint64_t bad_samples = 0;
+    uint64_t last_sample = ~0ULL;
+    uint64_t counts[NUM_OVF_STAGES][4] = {};
+};
+
+//=============================================================================
+// Signal Logger
+//=============================================================================
+
+/**
+ * @brief Per-sample logger for internal state, one .npy file per signal.
+ *
+ * Each selected signal is read from the probe ports on the audio_valid
+ * cycle and appended to its own single-column TableWriter, so a run of
+ * N samples gives N-row arrays that np.load(..., mmap_mode='r') reads
+ * without parsing. The column order is written to signals.txt in the same
+ * directory (sim_io.load_signals). Outside the audio_valid cycle the cost
+ * is one branch per clock.
+ *
+ * Signals:
+ *   phase0..2      19-bit phase accumulators (multi_voice phase_regs)
+ *   vol0..2        Q8.16 envelope levels (envelope vol_regs)
+ *   adsr0..2       ADSR state: 0 attack, 1 decay, 2 sustain, 3 release
+ *   bypass_accum   Unfiltered voice sum
+ *   filter_accum   Filtered voice sum (SVF input)
+ *   svf_band       SVF band-pass state
+ *   svf_low        SVF low-pass state
+ *   svf_out        Saturated SVF output
+ *
+ * @tparam Top  Verilated wrapper with the tb_tt6581 probe ports.
+ */
+template <typename Top>
+class SignalLogger {
+public:
+    ~SignalLogger() { close(); }
+
+    /**
+     * @brief Enable the logger from plusargs.
+     *
+     * +siglog[=dir]             Enable, default directory tmp/signals
+     * +siglog_signals=a,b,...   Log only these signals; a name also selects
+     *                           every signal it prefixes (phase, vol, svf)
+     *
+     * @return  true if at least one signal is being logged.
+     */
+    bool open(int argc, char** argv) {
+        if (!has_plusarg(argc, argv, "siglog")) return false;
+
+        dir = get_plusarg(argc, argv, "siglog", "tmp/signals");
+        std::vector<std::string> wanted;
+        std::stringstream list(get_plusarg(argc, argv, "siglog_signals"));
+        for (std::string name; std::getline(list, name, ',');) {
+            if (!name.empty()) wanted.push_back(name);
+        }
+
+        Verilated::mkdir(dir.c_str());
+        for (auto& c : all_columns()) {
+            bool use = wanted.empty();
+            for (auto& w : wanted) use |= c->name.rfind(w, 0) == 0;
+            if (!use) continue;
+            if (!c->open(dir)) {
+                std::cerr << "[TB] Error: Could not open " << dir << "/" << c->name << ".npy" << std::endl;
+                return false;
+            }
+            columns.push_back(std::move(c));
+        }
+        if (columns.empty()) {
+            std::cerr << "[TB] Error: +siglog_signals matches no signal" << std::endl;
+            return false;
+        }
+
+        std::ofstream index(dir + "/signals.txt");
+        if (!index.is_open()) {
+            std::cerr << "[TB] Error: Could not open " << dir << "/signals.txt" << std::endl;
+            return false;
+        }
+        for (auto& c : columns) index << c->name << "\n";
+
+        std::cout << "[TB] Signal log: " << columns.size() << " signals per sample to " << dir << std::endl;
+        active = true;
+        return true;
+    }
+
+    /**
+     * @brief Log the selected signals if this clock carries an output sample.
+     */
+    void sample(const Top& top) {
+        if (!active || !top.audio_valid_o) return;
+        for (auto& c : columns) c->push(top);
+        rows++;
+    }
+
+    /**
+     * @brief Finalize and close the column files.
+     */
+    void close() {
+        if (!active) return;
+        for (auto& c : columns) c->close();
+        active = false;
+        std::cout << "[TB] Signal log: " << rows << " samples in " << dir << std::endl;
+    }
+
+private:
+    struct ColumnBase {
+        std::string name;
+        virtual ~ColumnBase() = default;
+        virtual bool open(const std::string& dir) = 0;
+        virtual void push(const Top& top) = 0;
+        virtual void close() = 0;
+    };
+
+    template <typename T>
+    struct Column : ColumnBase {
+        T (*get)(const Top&);
+        TableWriter<T> out;
+
+        bool open(const std::string& dir) override { return out.open(dir + "/" + this->name, {this->name}); }
+        void push(const Top& top) override { out.row(get(top)); }
+        void close() override { out.close(); }
+    };
+
+    template <typename T>
+    static std::unique_ptr<ColumnBase> column(const char* name, T (*get)(const Top&)) {
+        auto c  = std::make_unique<Column<T>>();
+        c->name = name;
+        c->get  = get;
+        return c;
+    }
+
+    static std::vector<std::unique_ptr<ColumnBase>> all_columns() {
+        std::vector<std::unique_ptr<ColumnBase>> c;
+        c.push_back(column<uint32_t>("phase0", [](const Top& t) -> uint32_t { return t.phase0_o; }));
+        c.push_back(column<uint32_t>("phase1", [](const Top& t) -> uint32_t { return t.phase1_o; }));
+        c.push_back(column<uint32_t>("phase2", [](const Top& t) -> uint32_t { return t.phase2_o; }));
+        c.push_back(column<uint32_t>("vol0",   [](const Top& t) -> uint32_t { return t.vol0_o; }));
+        c.push_back(column<uint32_t>("vol1",   [](const Top& t) -> uint32_t { return t.vol1_o; }));
+        c.push_back(column<uint32_t>("vol2",   [](const Top& t) -> uint32_t { return t.vol2_o; }));
+        c.push_back(column<uint8_t>("adsr0",   [](const Top& t) -> uint8_t { return t.adsr_o & 3; }));
+        c.push_back(column<uint8_t>("adsr1",   [](const Top& t) -> uint8_t { return (t.adsr_o >> 2) & 3; }));
+        c.push_back(column<uint8_t>("adsr2",   [](const Top& t) -> uint8_t { return (t.adsr_o >> 4) & 3; }));
+        c.push_back(column<int16_t>("bypass_accum", [](const Top& t) -> int16_t { return wrap_signed<14>(t.bypass_accum_o); }));
+        c.push_back(column<int16_t>("filter_accum", [](const Top& t) -> int16_t { return wrap_signed<14>(t.filter_accum_o); }));
+        c.push_back(column<int32_t>("svf_band", [](const Top& t) -> int32_t { return wrap_signed<24>(t.svf_band_o); }));
+        c.push_back(column<int32_t>("svf_low",  [](const Top& t) -> int32_t { return wrap_signed<24>(t.svf_low_o); }));
+        c.push_back(column<int16_t>("svf_out",  [](const Top& t) -> int16_t { return wrap_signed<14>(t.svf_out_o); }));
+        return c;
+    }
+
+    std::string                              dir;
+    std::vector<std::unique_ptr<ColumnBase>> columns;
+    uint64_t                                 rows   = 0;
+    bool                                     active = false;
+};
+
+//=============================================================================
+// Register Write Log
+//=============================================================================
+
+/**
+ * @brief Log of every register write seen on the reg_file port.
+ *
+ * Written in the player's stimulus format (clk_tick addr data), with the
+ * harness clock count at the reg_we_o strobe, so a render can be replayed
+ * with +stimulus= and the regression runner can list the writes around a
+ * divergence.
+ *
+ * @tparam Top  Verilated wrapper with the tb_tt6581 probe ports.
+ */
+template <typename Top>
+class RegWriteLog {
+public:
+    /**
+     * @brief Enable the log from plusargs.
+     *
+     * +reg_log[=path]   Enable, default path tmp/reg_log.txt
+     */
+    bool open(int argc, char** argv) {
+        if (!has_plusarg(argc, argv, "reg_log")) return false;
+
+        std::string path = get_plusarg(argc, argv, "reg_log", "tmp/reg_log.txt");
+        file.open(path);
+        if (!file) {
+            std::cerr << "[TB] Error: Could not open " << path << std::endl;
+            return false;
+        }
+        file << "# TT6581 Stimulus File\n# Title: register write log\n# Format: clk_tick addr data\n";
+        active = true;
+        return true;
+    }
+
+    /**
+     * @brief Log the register write of this clock, if any.
+     */
+    void sample(const Top& top, uint64_t cycle) {
+        if (!active || !top.reg_we_o) return;
+        char line[48];
+        std::snprintf(line, sizeof(line), "%llu 0x%02X 0x%02X\n", (unsigned long long)cycle,
+                      top.reg_addr_o, top.reg_wdata_o);
+        file << line;
+    }
+
+    void close() {
+        if (active) file.close();
+        active = false;
+    }
+
+private:
+    std::ofstream file;
+    bool          active = false;
+};
+
+//=============================================================================
+// Waveform Trace
+//=============================================================================
+
+// WaveTrace trigger sources
+enum WaveTrigger {
+    TRIG_OVERFLOW = 1 << 0,     // First OverflowMonitor event
+    TRIG_MISMATCH = 1 << 1,     // Lockstep model mismatch reported by the bench
+    TRIG_REG      = 1 << 2,     // Register write matching +trace_on=reg:...
+};
+
+/**
+ * @brief Windowed and event-triggered FST waveform dump.
+ *
+ * Needs a model built with --trace-fst (make TRACE=1); otherwise every
+ * method is a no-op and the trace plusargs only print a warning. The
+ * model must be created after traceEverOn(WaveTrace::requested(...)).
+ *
+ * Without +trace_on, the run is dumped from +trace_start to +trace_end.
+ * With it, the trigger sources are armed over that window and the dump
+ * rotates between two segment files of +trace_pre each, so the previous
+ * segment always holds the time before the trigger. After the trigger the
+ * current segment continues for +trace_post and is renamed to the trace
+ * path; the previous one becomes <path>_pre.fst. An untriggered run leaves
+ * no file.
+ *
+ * @tparam Top  Verilated model. sample() needs the tb_tt6581 probe ports;
+ *              other benches call step() and trigger() directly.
+ */
+template <typename Top>
+class WaveTrace {
+public:
+    ~WaveTrace() { close(); }
+
+    /**
+     * @brief true if any waveform plusarg is given.
+     */
+    static bool requested(int argc, char** argv) {
+        for (const char* name : {"trace", "trace_start", "trace_end", "trace_on"}) {
+            if (has_plusarg(argc, argv, name)) return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Trigger on the first event of an overflow monitor.
+     */
+    void watch(const OverflowMonitor<Top>& monitor) { overflow = &monitor; }
+
+    /**
+     * @brief Configure from plusargs and start or arm the dump.
+     *
+     * +trace[=path]               Enable, default path def_path
+     * +trace_start=sec            Window start (default 0)
+     * +trace_end=sec              Window end (default: end of run)
+     * +trace_scope=a,b            Dump only these scopes (e.g. TOP.tb_tt6581.tt6581_inst.svf_inst)
+     * +trace_depth=N              Hierarchy levels below each scope (default 0: all)
+     * +trace_on=overflow,mismatch,reg:AA[=DD]
+     *                             Trigger sources; reg matches a write to
+     *                             address AA (with data DD), both hex
+     * +trace_pre=ms               Kept before the trigger (default 5)
+     * +trace_post=ms              Dumped after the trigger (default 5)
+     *
+     * @param top       Model to trace.
+     * @param def_path  Default output path.
+     * @return          true if the dump is enabled.
+     */
+    bool open(int argc, char** argv, Top& top, const std::string& def_path) {
+        if (!requested(argc, argv)) return false;
+#if VM_TRACE_FST
+        path      = get_plusarg(argc, argv, "trace", def_path);
+        start_cyc = (uint64_t)(std::stod(get_plusarg(argc, argv, "trace_start", "0")) * CLK_FREQ_HZ);
+        std::string end = get_plusarg(argc, argv, "trace_end");
+        if (!end.empty()) end_cyc = (uint64_t)(std::stod(end) * CLK_FREQ_HZ);
+        pre_cyc  = std::max<uint64_t>(1, get_plusarg_int(argc, argv, "trace_pre", 5) * (CLK_FREQ_HZ / 1000));
+        post_cyc = get_plusarg_int(argc, argv, "trace_post", 5) * (CLK_FREQ_HZ / 1000);
+
+        std::stringstream on(get_plusarg(argc, argv, "trace_on"));
+        for (std::string src; std::getline(on, src, ',');) {
+            if (src == "overflow")            triggers |= TRIG_OVERFLOW;
+            else if (src == "mismatch")       triggers |= TRIG_MISMATCH;
+            else if (src.rfind("reg:", 0) == 0) {
+                triggers |= TRIG_REG;
+                size_t eq = src.find('=');
+                reg_addr = std::stoi(src.substr(4, eq - 4), nullptr, 16);
+                if (eq != std::string::npos) reg_data = std::stoi(src.substr(eq + 1), nullptr, 16);
+            } else {
+                std::cerr << "[TB] Error: Unknown trace trigger '" << src << "'" << std::endl;
+                return false;
+            }
+        }
+
+        tfp = std::make_unique<VerilatedFstC>();
+        int depth = get_plusarg_int(argc, argv, "trace_depth", 0);
+        std::stringstream scopes(get_plusarg(argc, argv, "trace_scope"));
+        for (std::string scope; std::getline(scopes, scope, ',');) {
+            if (!scope.empty()) tfp->dumpvars(depth, scope);
+        }
+        top.trace(tfp.get(), 99);
+
+        std::string stem = path.substr(0, path.rfind(".fst"));
+        seg_path[0] = stem + "_seg0.fst";
+        seg_path[1] = stem + "_seg1.fst";
+        pre_path    = stem + "_pre.fst";
+
+        std::cout << "[TB] Waveform: " << (double)start_cyc / CLK_FREQ_HZ << " s to ";
+        if (end_cyc == UINT64_MAX) std::cout << "end";
+        else                       std::cout << (double)end_cyc / CLK_FREQ_HZ << " s";
+        if (triggers) {
+            std::cout << ", armed on " << get_plusarg(argc, argv, "trace_on") << " ("
+                      << pre_cyc * 1000 / CLK_FREQ_HZ << " ms before, "
+                      << post_cyc * 1000 / CLK_FREQ_HZ << " ms after)";
+        }
+        std::cout << " to " << path << std::endl;
+        state = WAIT;
+        return true;
+#else
+        (void)top;
+        (void)def_path;
+        for (const char* name : {"trace_start", "trace_end", "trace_on"}) {
+            if (has_plusarg(argc, argv, name)) {
+                std::cerr << "[TB] Warning: +" << name << " needs a TRACE=1 build, no waveform written" << std::endl;
+                break;
+            }
+        }
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Dump the model at one clock edge (called from tick()).
+     */
+    void dump(uint64_t time) {
+#if VM_TRACE_FST
+        if (state >= RECORD && state <= POST) tfp->dump(time);
+#else
+        (void)time;
+#endif
+    }
+
+    /**
+     * @brief Check the register-write and overflow triggers, then step().
+     *
+     * @param top    Model with the tb_tt6581 probe ports.
+     * @param cycle  Current system clock cycle.
+     */
+    void sample(const Top& top, uint64_t cycle) {
+        if (state == ARMED) {
+            if ((triggers & TRIG_REG) && top.reg_we_o && top.reg_addr_o == reg_addr &&
+                (reg_data < 0 || top.reg_wdata_o == reg_data)) {
+                char what[48];
+                std::snprintf(what, sizeof(what), "register write 0x%02X = 0x%02X", reg_addr, top.reg_wdata_o);
+                trigger(cycle, TRIG_REG, what);
+            }
+            if (overflow && overflow->total()) trigger(cycle, TRIG_OVERFLOW, "overflow");
+        }
+        step(cycle);
+    }
+
+    /**
+     * @brief Advance the window and segment rotation to a clock cycle.
+     */
+    void step(uint64_t cycle) {
+        switch (state) {
+            case WAIT:
+                if (cycle >= start_cyc) {
+                    if (triggers) {
+                        state = ARMED;
+                        open_segment(0, cycle);
+                    } else {
+                        state = RECORD;
+                        open_file(path);
+                    }
+                }
+                break;
+            case RECORD:
+                if (cycle >= end_cyc) close();
+                break;
+            case ARMED:
+                if (cycle >= end_cyc) close();
+                else if (cycle - seg_start >= pre_cyc) open_segment(cur ^ 1, cycle);
+                break;
+            case POST:
+                if (cycle >= post_end) close();
+                break;
+            default:
+                break;
+        }
+    }
+
+    /**
+     * @brief Report a trigger event; ignored unless the source is armed.
+     *
+     * @param cycle   Current system clock cycle.
+     * @param source  WaveTrigger bit.
+     * @param what    Description for the log.
+     */
+    void trigger(uint64_t cycle, int source, const std::string& what) {
+        if (state != ARMED || !(triggers & source)) return;
+        std::cout << "[TB] Waveform: triggered by " << what << " at "
+                  << (double)cycle / CLK_FREQ_HZ << " s" << std::endl;
+        post_end = cycle + post_cyc;
+        state    = POST;
+    }
+
+    /**
+     * @brief Finish the dump; an armed, untriggered dump is discarded.
+     */
+    void close() {
+#if VM_TRACE_FST
+        if (state < RECORD || state > POST) return;
+        tfp->close();
+        if (state == ARMED) {
+            std::remove(seg_path[0].c_str());
+            std::remove(seg_path[1].c_str());
+            std::cout << "[TB] Waveform: no trigger, nothing written" << std::endl;
+        } else if (state == POST) {
+            std::rename(seg_path[cur].c_str(), path.c_str());
+            if (have_prev) std::rename(seg_path[cur ^ 1].c_str(), pre_path.c_str());
+            std::cout << "[TB] Waveform: wrote " << path << (have_prev ? " and " + pre_path : "") << std::endl;
+        } else {
+            std::cout << "[TB] Waveform: wrote " << path << std::endl;
+        }
+        state = DONE;
+#endif
+    }
+
+private:
+    enum State { OFF, WAIT, RECORD, ARMED, POST, DONE };
+
+    void open_file(const std::string& file) {
+#if VM_TRACE_FST
+        ScopedPhase phase(PHASE_IO);
+        if (tfp->isOpen()) tfp->close();
+        tfp->open(file.c_str());
+#else
+        (void)file;
+#endif
+    }
+
+    void open_segment(int seg, uint64_t cycle) {
+        have_prev = seg != cur;
+        cur       = seg;
+        seg_start = cycle;
+        open_file(seg_path[seg]);
+    }
+
+#if VM_TRACE_FST
+    std::unique_ptr<VerilatedFstC> tfp;
+#endif
+
+    const OverflowMonitor<Top>* overflow = nullptr;
+    State       state     = OFF;
+    std::string path;
+    std::string seg_path[2];
+    std::string pre_path;
+    uint64_t    start_cyc = 0;
+    uint64_t    end_cyc   = UINT64_MAX;
+    uint64_t    pre_cyc   = 0;
+    uint64_t    post_cyc  = 0;
+    uint64_t    post_end  = 0;
+    uint64_t    seg_start = 0;
+    int         cur       = 0;
+    bool        have_prev = false;
+    int         triggers  = 0;
+    int         reg_addr  = -1;
+    int         reg_data  = -1;
+};
+
+//=============================================================================
+// Instrument Set
+//=============================================================================
+
+/**
+ * @brief Every monitor above, fed from one set of hooks.
+ *
+ * The top-level modes hold one instance and call sample() once per system
+ * clock; each monitor still enables itself from its own plusargs. A new
+ * monitor is added here, not in each mode.
+ *
+ * @tparam Top  Verilated wrapper with the tb_tt6581 probe ports.
+ */
+template <typename Top>
+struct SimInstruments {
+    Timeline<Top>        timeline;
+    MultUsage<Top>       mult_usage;
+    CycleBudget<Top>     cycle_budget;
+    OverflowMonitor<Top> overflow;
+    SignalLogger<Top>    siglog;
+    RegWriteLog<Top>     reg_log;
+    WaveTrace<Top>       wave;      // Passed to tick() by the mode
+
+    /**
+     * @brief Configure every monitor from plusargs.
+     *
+     * @param top       Model to trace.
+     * @param fst_path  Default waveform path of the mode.
+     */
+    void open(int argc, char** argv, Top& top, const std::string& fst_path) {
+        timeline.open(argc, argv);
+        mult_usage.open(argc, argv);
+        cycle_budget.open(argc, argv);
+        overflow.open(argc, argv);
+        siglog.open(argc, argv);
+        reg_log.open(argc, argv);
+        wave.watch(overflow);
+        wave.open(argc, argv, top, fst_path);
+    }
+
+    /**
+     * @brief Sample one system clock, after the model has been ticked.
+     */
+    void sample(const Top& top, uint64_t cycle) {
+        timeline.sample(top, cycle);
+        mult_usage.sample(top);
+        cycle_budget.sample(top);
+        overflow.sample(top);
+        siglog.sample(top);
+        reg_log.sample(top, cycle);
+        wave.sample(top, cycle);
+    }
+
+    /**
+     * @brief Close the output files; call before the model's final().
+     */
+    void close() {
+        timeline.close();
+        siglog.close();
+        reg_log.close();
+        wave.close();
+    }
+
+    /**
+     * @brief Print the end-of-run summaries.
+     */
+    void report() {
+        report_ok &= mult_usage.report();
+        report_ok &= cycle_budget.report();
+        overflow.report();
+    }
+
+    /**
+     * @brief 1 if a report could not be written or +overflow_fail tripped.
+     */
+    int exit_code() const { return (!report_ok || overflow.exit_code()) ? 1 : 0; }
+
+private:
+    bool report_ok = true;
+};
+
+#endif // SIM_TRACE_H
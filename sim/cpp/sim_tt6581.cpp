@@ -1,7 +1,7 @@
 //-------------------------------------------------------------------------------------------------
 //
 //  File: sim_tt6581.cpp
-//  Description: Verilator testbench for TT6581.
+//  Description: Verilator testbench for TT6581, song mode.
 //               Plays a 10 second song utilizing most of the TT6581.
 //
 //  Author:
@@ -10,6 +10,8 @@
 //-------------------------------------------------------------------------------------------------
 
 #include "sim_common.h"
+#include "sim_trace.h"
+#include "sim_tt6581.h"
 #include "Vtb_tt6581.h"
 
 #include <vector>
@@ -77,19 +79,22 @@ void add_arpeggio(std::vector<NoteEvent>& events,
     events.push_back({(uint64_t)((end_s - 0.02) * sr), voice, 0, wave, EventType::GATE_OFF});
 }
 
-int main(int argc, char** argv) {
+int run_song(int argc, char** argv) {
+    sim_stats.enter(PHASE_SETUP);
     Verilated::mkdir("logs");
     const std::unique_ptr<VerilatedContext> contextp{new VerilatedContext};
     contextp->commandArgs(argc, argv);
-    contextp->traceEverOn(false);
+    contextp->traceEverOn(WaveTrace<Vtb_tt6581>::requested(argc, argv));
     const std::unique_ptr<Vtb_tt6581> top{new Vtb_tt6581{contextp.get(), "TOP"}};
 
     PdmCapture pdm;
+    SimInstruments<Vtb_tt6581> inst;
     uint64_t tick_count = 0;
 
     auto sys_tick = [&]() {
-        tick(contextp, top);
+        tick(contextp, top, inst.wave);
         tick_count++;
+        inst.sample(*top, tick_count);
         if (pdm.active && (tick_count % CYCLES_PER_DAC == 0)) {
             pdm.capture(top->wave_o);
         }
@@ -246,6 +251,8 @@ int main(int argc, char** argv) {
 
     tick_count = 0;
     pdm.active = true;
+    inst.open(argc, argv, *top, "logs/tb_tt6581.fst");
+    sim_stats.enter(PHASE_EVAL);
 
     size_t event_idx = 0;
     size_t filt_idx  = 0;
@@ -278,16 +285,18 @@ int main(int argc, char** argv) {
         total_samples++;
 
         if (total_samples % SAMPLE_RATE_HZ == 0) {
-            std::cout << "[TB] Time: " << (total_samples / SAMPLE_RATE_HZ)
-                      << "s / " << (int)DURATION << "s" << std::endl;
+            sim_stats.progress(total_samples * CYCLES_PER_SAMPLE, max_samples * CYCLES_PER_SAMPLE);
         }
     }
 
     pdm.flush();
+    inst.close();
     top->final();
 
     std::cout << "[TB] PDM samples captured: " << pdm.total
               << " (" << (double)pdm.total / DAC_RATE_HZ << "s at "
               << DAC_RATE_HZ / 1000000 << " MHz)" << std::endl;
-    return 0;
+    report_profile(argc, argv, contextp, "tt6581");
+    inst.report();
+    return inst.exit_code();
 }
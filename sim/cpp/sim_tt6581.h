@@ -0,0 +1,21 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  File: sim_tt6581.h
+//  Description: Modes of the tt6581 simulator binary. Every mode is a
+//               harness around the same Verilated tb_tt6581 model and is
+//               selected by the first command line argument.
+//
+//  Author:
+//    - Andreas Pedersen
+//
+//-------------------------------------------------------------------------------------------------
+
+#ifndef SIM_TT6581_H
+#define SIM_TT6581_H
+
+int run_song(int argc, char** argv);     // sim_tt6581.cpp: 10 second demo song
+int run_player(int argc, char** argv);   // sim_tt6581_player.cpp: SID stimulus playback
+int run_bode(int argc, char** argv);     // sim_tt6581_bode.cpp: stepped sine sweep
+int run_spi_budget(int argc, char** argv);  // sim_tt6581_spi_budget.cpp: SPI budget of a stimulus file
+
+#endif // SIM_TT6581_H
@@ -1,7 +1,7 @@
 //-------------------------------------------------------------------------------------------------
 //
 //  File: sim_tt6581_bode.cpp
-//  Description: Verilator testbench for TT6581.
+//  Description: Verilator testbench for TT6581, bode mode.
 //               Plays a stepped frequency sweep (20 Hz-20 kHz) through Voice 0
 //               with a 1 kHz LP filter applied and captures the PDM output.
 //
@@ -11,21 +11,26 @@
 //-------------------------------------------------------------------------------------------------
 
 #include "sim_common.h"
-#include "Vtb_tt6581_bode.h"
+#include "sim_trace.h"
+#include "sim_tt6581.h"
+#include "Vtb_tt6581.h"
 
-int main(int argc, char** argv) {
+int run_bode(int argc, char** argv) {
+    sim_stats.enter(PHASE_SETUP);
     Verilated::mkdir("logs");
     const std::unique_ptr<VerilatedContext> contextp{new VerilatedContext};
     contextp->commandArgs(argc, argv);
-    contextp->traceEverOn(false);
-    const std::unique_ptr<Vtb_tt6581_bode> top{new Vtb_tt6581_bode{contextp.get(), "TOP"}};
+    contextp->traceEverOn(WaveTrace<Vtb_tt6581>::requested(argc, argv));
+    const std::unique_ptr<Vtb_tt6581> top{new Vtb_tt6581{contextp.get(), "TOP"}};
 
     PdmCapture pdm;
+    SimInstruments<Vtb_tt6581> inst;
     uint64_t tick_count = 0;
 
     auto sys_tick = [&]() {
-        tick(contextp, top);
+        tick(contextp, top, inst.wave);
         tick_count++;
+        inst.sample(*top, tick_count);
         if (pdm.active && (tick_count % CYCLES_PER_DAC == 0)) {
             pdm.capture(top->wave_o);
         }
@@ -81,14 +86,33 @@ int main(int argc, char** argv) {
 
     // Open output files
     pdm.open("tmp/bode.bin");
-    std::ofstream csv("tmp/bode.csv");
-    csv << "time_sec,freq_hz\n";
+    TableWriter<double, double> sched;
+    if (!sched.open("tmp/bode", {"time_sec", "freq_hz"}, has_plusarg(argc, argv, "csv"))) {
+        std::cerr << "[TB] Error: Could not open " << sched.filename() << std::endl;
+        return 1;
+    }
 
     tick_count = 0;
     pdm.active = true;
+    inst.open(argc, argv, *top, "logs/tb_tt6581_bode.fst");
+    sim_stats.enter(PHASE_EVAL);
 
     // Settle
     int settle_samples = (int)(0.05 * SAMPLE_RATE_HZ);
+
+    auto step_freq = [&](int step) {
+        double frac = (double)step / (NUM_STEPS - 1);
+        return START_FREQ * std::pow(END_FREQ / START_FREQ, frac);
+    };
+    auto step_samples = [&](double freq) {
+        return std::max(1, (int)(CYCLES_PER_STEP / freq * SAMPLE_RATE_HZ));
+    };
+
+    uint64_t total_cycles = (uint64_t)settle_samples * CYCLES_PER_SAMPLE;
+    for (int step = 0; step < NUM_STEPS; step++) {
+        total_cycles += (uint64_t)step_samples(step_freq(step)) * CYCLES_PER_SAMPLE;
+    }
+
     for (int i = 0; i < settle_samples; i++) {
         sys_tick_batch(CYCLES_PER_SAMPLE);
     }
@@ -97,32 +121,33 @@ int main(int argc, char** argv) {
 
     // Sweep
     for (int step = 0; step < NUM_STEPS; step++) {
-        double frac = (double)step / (NUM_STEPS - 1);
-        double freq = START_FREQ * std::pow(END_FREQ / START_FREQ, frac);
+        double freq = step_freq(step);
 
         set_voice_freq(top, sys_tick, V1_BASE, freq);
 
-        double dwell_sec    = CYCLES_PER_STEP / freq;
-        int    dwell_samples = std::max(1, (int)(dwell_sec * SAMPLE_RATE_HZ));
+        int dwell_samples = step_samples(freq);
 
         for (int s = 0; s < dwell_samples; s++) {
             sys_tick_batch(CYCLES_PER_SAMPLE);
-            csv << t_sec << "," << freq << "\n";
+            sched.row(t_sec, freq);
             t_sec += 1.0 / SAMPLE_RATE_HZ;
         }
 
         if (step % 10 == 0) {
-            std::cout << "[TB] Step " << step << "/" << NUM_STEPS
-                      << " (" << (int)freq << " Hz, "
-                      << dwell_samples << " samples)" << std::endl;
+            sim_stats.progress(tick_count, total_cycles,
+                               "Step " + std::to_string(step) + "/" + std::to_string(NUM_STEPS)
+                               + " (" + std::to_string((int)freq) + " Hz)");
         }
     }
 
     pdm.flush();
-    csv.close();
+    sched.close();
+    inst.close();
     top->final();
 
     std::cout << "\n[TB] PDM samples: " << pdm.total
               << " (" << (double)pdm.total / DAC_RATE_HZ << "s)" << std::endl;
-    return 0;
+    report_profile(argc, argv, contextp, "tt6581_bode");
+    inst.report();
+    return inst.exit_code();
 }
@@ -0,0 +1,162 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  File: sim_tt6581_lib.cpp
+//  Description: C interface to the Verilated TT6581, built as a shared library
+//               (make lib_tt6581) and loaded from Python by scripts/tt6581.py.
+//               The clock loop runs here; Python only exchanges whole blocks
+//               of samples. Handles may run on different Python threads, so
+//               the library is built with SIM_NO_STATS: spi_write and the
+//               table writers do no phase accounting, and sim_stats must not
+//               be used here.
+//
+//  Author:
+//    - Andreas Pedersen
+//
+//-------------------------------------------------------------------------------------------------
+
+#include "sim_common.h"
+#include "sim_model.h"
+#include "sim_snapshot.h"
+#include "Vtb_tt6581.h"
+#include "Vtb_tt6581___024root.h"
+
+#include <map>
+
+struct SavedState {
+    Snapshot<Vtb_tt6581> model;
+    uint64_t             tick_count;
+};
+
+struct TT6581Sim {
+    std::unique_ptr<VerilatedContext> contextp{new VerilatedContext};
+    std::unique_ptr<Vtb_tt6581>       top{new Vtb_tt6581{contextp.get(), "TOP"}};
+
+    int      spi_div    = 2;
+    uint64_t tick_count = 0;
+    int      next_snap  = 0;
+    std::map<int, SavedState> snapshots;
+
+    void sys_tick() {
+        tick(contextp, top);
+        tick_count++;
+    }
+};
+
+extern "C" {
+
+/**
+ * @brief Construct and reset a model.
+ *
+ * @param spi_div  SPI clock divider for pin-level register writes.
+ * @return         Simulator handle, freed with tt6581_destroy().
+ */
+TT6581Sim* tt6581_create(int spi_div) {
+    TT6581Sim* sim = new TT6581Sim;
+    sim->spi_div = spi_div;
+
+    sim->top->clk_i  = 0;
+    sim->top->rst_ni = 0;
+    sim->top->sclk_i = 0;
+    sim->top->cs_i   = 1;
+    sim->top->mosi_i = 0;
+
+    for (int i = 0; i < 5; i++) sim->sys_tick();
+    sim->top->rst_ni = 1;
+    for (int i = 0; i < 5; i++) sim->sys_tick();
+    return sim;
+}
+
+void tt6581_destroy(TT6581Sim* sim) {
+    sim->top->final();
+    delete sim;
+}
+
+uint64_t tt6581_ticks(TT6581Sim* sim) {
+    return sim->tick_count;
+}
+
+/**
+ * @brief Write a register.
+ *
+ * The pin-level path shifts a full SPI frame in through sclk_i/cs_i/mosi_i
+ * (spi_write in sim_common.h). The backdoor path loads the SPI block's
+ * address, data and write strobe registers directly, so reg_file takes the
+ * write on the next clock edge; it costs one clock instead of a frame.
+ *
+ * @param backdoor  Non-zero to bypass the SPI pins.
+ */
+void tt6581_write(TT6581Sim* sim, uint8_t addr, uint8_t data, int backdoor) {
+    if (!backdoor) {
+        spi_write(sim->top, [sim]() { sim->sys_tick(); }, addr, data, sim->spi_div);
+        return;
+    }
+
+    auto* root = sim->top->rootp;
+    root->tb_tt6581__DOT__tt6581_inst__DOT__spi_inst__DOT__reg_addr_o  = addr & 0x7F;
+    root->tb_tt6581__DOT__tt6581_inst__DOT__spi_inst__DOT__reg_wdata_o = data;
+    root->tb_tt6581__DOT__tt6581_inst__DOT__spi_inst__DOT__reg_we_o    = 1;
+    sim->sys_tick();
+}
+
+/**
+ * @brief Run a number of clocks and capture the output.
+ *
+ * @param ticks    System clocks to run.
+ * @param pcm      Final 14-bit samples, one per audio_valid (may be null).
+ * @param pcm_len  Capacity of pcm.
+ * @param pdm      PDM bits, one every CYCLES_PER_DAC clocks, packed MSB-first
+ *                 like PdmCapture (may be null, else ticks / 40 bytes rounded up).
+ * @return         Number of PCM samples produced.
+ */
+uint64_t tt6581_run(TT6581Sim* sim, uint64_t ticks,
+                    int16_t* pcm, uint64_t pcm_len, uint8_t* pdm) {
+    const uint64_t pdm_bits = ticks / CYCLES_PER_DAC;
+    if (pdm) std::memset(pdm, 0, (pdm_bits + 7) / 8);
+
+    uint64_t n_pcm = 0;
+    uint64_t n_pdm = 0;
+    for (uint64_t i = 1; i <= ticks; i++) {
+        sim->sys_tick();
+        if (sim->top->audio_valid_o) {
+            if (pcm && n_pcm < pcm_len) pcm[n_pcm] = wrap_signed<14>(sim->top->mult_out_o);
+            n_pcm++;
+        }
+        if (pdm && i % CYCLES_PER_DAC == 0) {
+            pdm[n_pdm >> 3] |= (sim->top->wave_o & 1) << (7 - (n_pdm & 7));
+            n_pdm++;
+        }
+    }
+    return n_pcm;
+}
+
+/**
+ * @brief Save the model state.
+ *
+ * @return  Snapshot id for tt6581_restore() and tt6581_release().
+ */
+int tt6581_snapshot(TT6581Sim* sim) {
+    const int id = sim->next_snap++;
+    auto& snap = sim->snapshots[id];
+    snap.model.save(sim->contextp, sim->top);
+    snap.tick_count = sim->tick_count;
+    return id;
+}
+
+/**
+ * @brief Return the model to a saved state.
+ *
+ * @return  0 on success, -1 if the id is unknown.
+ */
+int tt6581_restore(TT6581Sim* sim, int id) {
+    auto it = sim->snapshots.find(id);
+    if (it == sim->snapshots.end()) return -1;
+    it->second.model.restore(sim->contextp, sim->top);
+    sim->tick_count = it->second.tick_count;
+    return 0;
+}
+
+void tt6581_release(TT6581Sim* sim, int id) {
+    sim->snapshots.erase(id);
+}
+
+}
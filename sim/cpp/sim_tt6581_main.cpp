@@ -0,0 +1,47 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  File: sim_tt6581_main.cpp
+//  Description: Entry point of the tt6581 simulator binary.
+//               Usage: Vtb_tt6581 [song|player|bode|spi_budget] [+plusargs...]
+//
+//  Author:
+//    - Andreas Pedersen
+//
+//-------------------------------------------------------------------------------------------------
+
+#include "sim_tt6581.h"
+
+#include <cstdio>
+#include <cstring>
+
+struct SimMode {
+    const char* name;
+    int       (*run)(int argc, char** argv);
+    const char* help;
+};
+
+const SimMode SIM_MODES[] = {
+    {"song",       run_song,       "Play the 10 second demo song (default)"},
+    {"player",     run_player,     "Play a SID stimulus file (+stimulus=path)"},
+    {"bode",       run_bode,       "Stepped sine sweep through the filter"},
+    {"spi_budget", run_spi_budget, "SPI bandwidth budget of a stimulus file, without the RTL"},
+};
+
+int main(int argc, char** argv) {
+    // The mode is the first argument that is not a plusarg
+    const char* mode = "song";
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] != '+') {
+            mode = argv[i];
+            break;
+        }
+    }
+
+    for (const SimMode& m : SIM_MODES) {
+        if (std::strcmp(mode, m.name) == 0) return m.run(argc, argv);
+    }
+
+    std::fprintf(stderr, "Unknown mode '%s'\nUsage: %s [mode] [+plusargs...]\n", mode, argv[0]);
+    for (const SimMode& m : SIM_MODES) std::fprintf(stderr, "  %-10s %s\n", m.name, m.help);
+    return 2;
+}
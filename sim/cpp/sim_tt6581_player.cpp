@@ -1,7 +1,7 @@
 //-------------------------------------------------------------------------------------------------
 //
 //  File: sim_tt6581_player.cpp
-//  Description: Verilator testbench for TT6581.
+//  Description: Verilator testbench for TT6581, player mode.
 //               Plays SID stimulus captured from a MOS6502 emulator.
 //
 //  Author:
@@ -10,61 +10,31 @@
 //-------------------------------------------------------------------------------------------------
 
 #include "sim_common.h"
-#include "Vtb_tt6581_player.h"
+#include "sim_stimulus.h"
+#include "sim_trace.h"
+#include "sim_tt6581.h"
+#include "Vtb_tt6581.h"
 
-#include <sstream>
 #include <vector>
 
 const int SPI_CLK_DIV = 2;  // Fast SPI for stimulus playback
 
-struct StimulusEvent {
-    uint64_t clk_tick;
-    uint8_t  addr;
-    uint8_t  data;
-};
-
-std::vector<StimulusEvent> load_stimulus(const std::string& path) {
-    std::vector<StimulusEvent> events;
-    std::ifstream file(path);
-
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty() || line[0] == '#') continue;
-
-        StimulusEvent ev;
-        unsigned addr, data;
-        std::istringstream iss(line);
-
-        iss >> ev.clk_tick;
-
-        std::string token;
-        iss >> token;
-        addr = std::stoul(token, nullptr, 16);
-        ev.addr = addr;
-
-        iss >> token;
-        data = std::stoul(token, nullptr, 16);
-        ev.data = data;
-
-        events.push_back(ev);
-    }
-
-    return events;
-}
-
-int main(int argc, char** argv) {
+int run_player(int argc, char** argv) {
+    sim_stats.enter(PHASE_SETUP);
     Verilated::mkdir("logs");
     const std::unique_ptr<VerilatedContext> contextp{new VerilatedContext};
     contextp->commandArgs(argc, argv);
-    contextp->traceEverOn(false);
-    const std::unique_ptr<Vtb_tt6581_player> top{new Vtb_tt6581_player{contextp.get(), "TOP"}};
+    contextp->traceEverOn(WaveTrace<Vtb_tt6581>::requested(argc, argv));
+    const std::unique_ptr<Vtb_tt6581> top{new Vtb_tt6581{contextp.get(), "TOP"}};
 
     PdmCapture pdm;
+    SimInstruments<Vtb_tt6581> inst;
     uint64_t tick_count = 0;
 
     auto sys_tick = [&]() {
-        tick(contextp, top);
+        tick(contextp, top, inst.wave);
         tick_count++;
+        inst.sample(*top, tick_count);
         if (pdm.active && (tick_count % CYCLES_PER_DAC == 0)) {
             pdm.capture(top->wave_o);
         }
@@ -75,21 +45,19 @@ int main(int argc, char** argv) {
     };
 
     // Load stimulus
-    std::string stim_path = "stimulus/Hubbard_Rob_Monty_on_the_Run_tt6581_stimulus.txt";
-    for (int i = 1; i < argc; i++) {
-        std::string arg(argv[i]);
-        if (arg.rfind("+stimulus=", 0) == 0) {
-            stim_path = arg.substr(10);
-        }
-    }
+    std::string stim_path = get_plusarg(argc, argv, "stimulus", DEFAULT_STIMULUS);
 
     std::cout << "[TB] TT6581 SID Player" << std::endl;
     std::cout << "[TB] Loading stimulus: " << stim_path << std::endl;
 
     auto events = load_stimulus(stim_path);
     std::cout << "[TB] Loaded " << events.size() << " register writes" << std::endl;
+    if (events.empty()) {
+        std::cerr << "[TB] Error: No register writes in " << stim_path << std::endl;
+        return 1;
+    }
 
-    pdm.open("tmp/pdm_out.bin");
+    pdm.open("tmp/player_pdm.bin");
 
     // Initial pin state
     top->clk_i  = 0;
@@ -99,7 +67,11 @@ int main(int argc, char** argv) {
     top->mosi_i = 0;
 
     const uint64_t last_event_tick = events.back().clk_tick;
-    const uint64_t total_ticks     = last_event_tick + SAMPLE_RATE_HZ * CYCLES_PER_SAMPLE;
+    uint64_t       total_ticks     = last_event_tick + SAMPLE_RATE_HZ * CYCLES_PER_SAMPLE;
+
+    // +max_sec=N plays only the first N seconds
+    const long max_sec = get_plusarg_int(argc, argv, "max_sec", 0);
+    if (max_sec > 0) total_ticks = std::min<uint64_t>(total_ticks, max_sec * CLK_FREQ_HZ);
 
     const float duration_s = (float)total_ticks / CLK_FREQ_HZ;
     std::cout << "[TB] Duration: " << duration_s << "s ("
@@ -112,6 +84,8 @@ int main(int argc, char** argv) {
     for (int i = 0; i < 5; i++) sys_tick();
 
     pdm.active = true;
+    inst.open(argc, argv, *top, "logs/tb_tt6581_player.fst");
+    sim_stats.enter(PHASE_EVAL);
 
     size_t   event_idx    = 0;
     uint64_t sample_count = 0;
@@ -141,18 +115,20 @@ int main(int argc, char** argv) {
             next_sample = (sample_count + 1) * CYCLES_PER_SAMPLE;
 
             if (sample_count % SAMPLE_RATE_HZ == 0) {
-                std::cout << "[TB] Time: " << (sample_count / SAMPLE_RATE_HZ)
-                          << "s  Events: " << event_idx << "/" << events.size()
-                          << std::endl;
+                sim_stats.progress(tick_count, total_ticks,
+                                   "Events: " + std::to_string(event_idx) + "/" + std::to_string(events.size()));
             }
         }
     }
 
     pdm.flush();
+    inst.close();
     top->final();
 
     std::cout << "[TB] PDM samples captured: " << pdm.total
               << " (" << (double)pdm.total / DAC_RATE_HZ << "s at "
               << DAC_RATE_HZ / 1000000 << " MHz)" << std::endl;
-    return 0;
+    report_profile(argc, argv, contextp, "tt6581_player");
+    inst.report();
+    return inst.exit_code();
 }
@@ -0,0 +1,388 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  File: sim_tt6581_spi_budget.cpp
+//  Description: SPI bandwidth budget of a stimulus file (spi_budget mode).
+//               Replays the register writes through a model of the player's
+//               SPI host instead of the RTL: one write at a time, each
+//               taking a spi_write() frame, queued in order when the host
+//               falls behind. Reports write bursts, the SCLK needed for a
+//               maximum scheduling slip, the late frames at a given
+//               spi_div and the writes that could be dropped.
+//
+//  Author:
+//    - Andreas Pedersen
+//
+//-------------------------------------------------------------------------------------------------
+
+#include "sim_common.h"
+#include "sim_stimulus.h"
+#include "sim_tt6581.h"
+
+#include <vector>
+
+//=============================================================================
+// Host Model
+//=============================================================================
+
+// Per player frame at one frame cost
+struct FrameBudget {
+    uint32_t writes   = 0;
+    uint32_t dropped  = 0;      // Redundant writes (see reduce_writes)
+    uint32_t burst    = 0;      // Largest queued burst starting in this frame
+    uint64_t busy     = 0;      // Bus clocks of the writes requested in this frame
+    uint64_t max_slip = 0;      // Worst start delay in clocks
+};
+
+struct BusResult {
+    uint64_t max_slip    = 0;   // Clocks
+    uint64_t p99_slip    = 0;
+    uint64_t late_writes = 0;   // Start delay above the limit
+    uint64_t late_frames = 0;
+    uint32_t peak_burst  = 0;   // Most writes in one busy period of the bus
+    double   peak_busy   = 0.0; // Largest busy fraction of a frame
+};
+
+/**
+ * @brief Queue every write behind the previous one at a fixed frame cost.
+ *
+ * A write starts at its request tick or when the previous frame ends,
+ * whichever is later; the difference is its slip. Writes that queue behind
+ * each other form a burst.
+ *
+ * @param cost        Bus clocks per write.
+ * @param limit       Slip above which a write is late.
+ * @param frame_ticks Clocks per player frame.
+ * @param frames      Per-frame detail, filled if non-null (sized by the caller).
+ */
+BusResult simulate_bus(const std::vector<StimulusEvent>& events, uint64_t cost, uint64_t limit,
+                       uint64_t frame_ticks, std::vector<FrameBudget>* frames = nullptr) {
+    BusResult r;
+    std::vector<uint64_t> slips;    // Non-zero only, most writes do not wait
+
+    uint64_t bus_free    = 0;
+    uint32_t burst       = 0;
+    size_t   burst_frame = 0;
+    int64_t  last_late   = -1;
+    uint32_t frame_max   = 0;       // Most writes requested in one frame
+    uint32_t frame_count = 0;
+    size_t   cur_frame   = 0;
+    uint64_t next_frame  = frame_ticks;
+
+    for (size_t i = 0; i < events.size(); i++) {
+        const uint64_t t     = events[i].clk_tick;
+        const uint64_t start = std::max(t, bus_free);
+        const uint64_t slip  = start - t;
+        bus_free = start + cost;
+        if (slip) slips.push_back(slip);
+
+        // Ticks are in order, so the frame only moves forward
+        if (t >= next_frame) {
+            cur_frame   = t / frame_ticks;
+            next_frame  = (cur_frame + 1) * frame_ticks;
+            frame_count = 0;
+        }
+        frame_max = std::max(frame_max, ++frame_count);
+
+        // A write that does not wait starts a new burst
+        burst = slip ? burst + 1 : 1;
+        if (!slip) burst_frame = cur_frame;
+        r.peak_burst = std::max(r.peak_burst, burst);
+        r.max_slip   = std::max(r.max_slip, slip);
+
+        if (slip > limit) {
+            r.late_writes++;
+            if ((int64_t)cur_frame != last_late) r.late_frames++;
+            last_late = cur_frame;
+        }
+
+        if (frames) {
+            FrameBudget& f = (*frames)[cur_frame];
+            f.writes++;
+            f.busy    += cost;
+            f.max_slip = std::max(f.max_slip, slip);
+            FrameBudget& b = (*frames)[burst_frame];
+            b.burst = std::max(b.burst, burst);
+        }
+    }
+    r.peak_busy = (double)frame_max * cost / frame_ticks;
+
+    // 1 % of all writes wait longer than p99_slip
+    const size_t above = events.size() / 100;
+    if (slips.size() > above) {
+        const size_t k = slips.size() - 1 - above;
+        std::nth_element(slips.begin(), slips.begin() + k, slips.end());
+        r.p99_slip = slips[k];
+    }
+    return r;
+}
+
+// Worst slip only, for the SCLK search
+uint64_t max_slip(const std::vector<StimulusEvent>& events, uint64_t cost) {
+    uint64_t bus_free = 0, worst = 0;
+    for (const auto& ev : events) {
+        const uint64_t start = std::max(ev.clk_tick, bus_free);
+        worst    = std::max(worst, start - ev.clk_tick);
+        bus_free = start + cost;
+    }
+    return worst;
+}
+
+/**
+ * @brief Largest frame cost that keeps every slip within the limit.
+ *
+ * The slip only grows with the cost, so this is a bisection between a
+ * cost known to pass and one known to fail (the divider table gives a
+ * tight bracket).
+ *
+ * @return  Bus clocks per write, or 0 if even the 20-clock CS gap alone is too slow.
+ */
+uint64_t max_frame_cost(const std::vector<StimulusEvent>& events, uint64_t limit,
+                        uint64_t lo, uint64_t hi) {
+    if (max_slip(events, lo) > limit) return 0;
+    if (max_slip(events, hi) <= limit) return hi;
+    while (hi - lo > 1) {
+        const uint64_t mid = lo + (hi - lo) / 2;
+        if (max_slip(events, mid) <= limit) lo = mid;
+        else                                hi = mid;
+    }
+    return lo;
+}
+
+// SCLK of a frame cost: 16.5 SCLK periods plus the 20-clock CS gap
+inline double cost_to_sclk_hz(uint64_t cost) {
+    return cost > spi_frame_ticks(0) ? 16.5 * CLK_FREQ_HZ / (cost - spi_frame_ticks(0)) : INFINITY;
+}
+
+//=============================================================================
+// Redundant Writes
+//=============================================================================
+
+struct ReduceResult {
+    std::vector<StimulusEvent> kept;
+    std::vector<bool>          dropped;     // Per input write
+    uint64_t unmapped    = 0;   // Address above the register map
+    uint64_t overwritten = 0;   // Same register written again before the next sample
+    uint64_t same_value  = 0;   // Value the register already holds
+};
+
+/**
+ * @brief Drop the writes that cannot change the output.
+ *
+ * The controller reads the registers once per sample, so of several writes
+ * to one register before the same sample tick only the last one counts.
+ * Of the rest, a write of the value the register already holds (reset
+ * value 0) has no effect. Both are judged on request times.
+ */
+ReduceResult reduce_writes(const std::vector<StimulusEvent>& events) {
+    ReduceResult r;
+    r.dropped.assign(events.size(), false);
+
+    // Next write to the same register
+    std::vector<size_t> next_same(events.size(), SIZE_MAX);
+    std::vector<size_t> seen(256, SIZE_MAX);
+    for (size_t i = events.size(); i-- > 0;) {
+        next_same[i] = seen[events[i].addr];
+        seen[events[i].addr] = i;
+    }
+
+    uint8_t regs[256] = {};
+    for (size_t i = 0; i < events.size(); i++) {
+        const auto& ev = events[i];
+        const size_t nx = next_same[i];
+        if (ev.addr > LAST_REG_ADDR) {
+            r.unmapped++;
+        } else if (nx != SIZE_MAX &&
+                   events[nx].clk_tick / CYCLES_PER_SAMPLE == ev.clk_tick / CYCLES_PER_SAMPLE) {
+            r.overwritten++;
+        } else if (regs[ev.addr] == ev.data) {
+            r.same_value++;
+        } else {
+            regs[ev.addr] = ev.data;
+            r.kept.push_back(ev);
+            continue;
+        }
+        r.dropped[i] = true;
+    }
+    return r;
+}
+
+//=============================================================================
+// Report
+//=============================================================================
+
+inline double ticks_to_us(uint64_t t) {
+    return 1e6 * t / CLK_FREQ_HZ;
+}
+
+int run_spi_budget(int argc, char** argv) {
+    const std::string stim_path = get_plusarg(argc, argv, "stimulus", DEFAULT_STIMULUS);
+    const int      spi_div  = (int)get_plusarg_int(argc, argv, "spi_div", 2);
+    const int      max_div  = (int)get_plusarg_int(argc, argv, "max_div", 32);
+    const double   slip_us  = std::stod(get_plusarg(argc, argv, "max_slip_us", "20"));
+    const long     late_log = get_plusarg_int(argc, argv, "late_log", 10);
+    const unsigned threads  = sim_threads(argc, argv);
+    const bool     csv      = has_plusarg(argc, argv, "csv");
+    const uint64_t limit    = (uint64_t)(slip_us * CLK_FREQ_HZ / 1e6);
+
+    std::cout << "[TB] SPI Bandwidth Budget" << std::endl;
+    std::cout << "[TB] Loading stimulus: " << stim_path << std::endl;
+
+    auto t0 = std::chrono::steady_clock::now();
+    double frame_hz = 50.0;
+    const auto events = load_stimulus(stim_path, &frame_hz);
+    if (events.empty()) {
+        std::cerr << "[TB] Error: No register writes in " << stim_path << std::endl;
+        return 1;
+    }
+    if (!std::is_sorted(events.begin(), events.end(),
+                        [](const StimulusEvent& a, const StimulusEvent& b) { return a.clk_tick < b.clk_tick; })) {
+        std::cerr << "[TB] Error: Stimulus ticks are not in order" << std::endl;
+        return 1;
+    }
+
+    // +frame_hz=N overrides the frame rate from the stimulus header
+    frame_hz = std::stod(get_plusarg(argc, argv, "frame_hz", std::to_string(frame_hz)));
+    const uint64_t frame_ticks = (uint64_t)std::llround(CLK_FREQ_HZ / frame_hz);
+    const size_t num_frames = events.back().clk_tick / frame_ticks + 1;
+
+    // Densest sample period
+    size_t peak_win = 0, peak_at = 0;
+    for (size_t i = 0, j = 0; i < events.size(); i++) {
+        while (events[i].clk_tick - events[j].clk_tick >= CYCLES_PER_SAMPLE) j++;
+        if (i - j + 1 > peak_win) {
+            peak_win = i - j + 1;
+            peak_at  = j;
+        }
+    }
+
+    const ReduceResult reduced = reduce_writes(events);
+
+    // One host simulation per divider, on all writes and on the reduced list
+    std::vector<int> divs;
+    for (int d = 2; d <= max_div; d += 2) divs.push_back(d);
+    std::vector<BusResult> full(divs.size()), lean(divs.size());
+    parallel_for(2 * divs.size(), threads, [&](size_t i, unsigned) {
+        const uint64_t cost = spi_frame_ticks(divs[i % divs.size()]);
+        if (i < divs.size()) full[i]               = simulate_bus(events, cost, limit, frame_ticks);
+        else                 lean[i - divs.size()] = simulate_bus(reduced.kept, cost, limit, frame_ticks);
+    });
+
+    uint64_t need_cost[2];
+    parallel_for(2, threads, [&](size_t i, unsigned) {
+        const auto& res = i ? lean : full;
+        uint64_t lo = spi_frame_ticks(0) + 1, hi = CLK_FREQ_HZ;
+        for (size_t k = 0; k < divs.size(); k++) {
+            if (res[k].max_slip <= limit) lo = spi_frame_ticks(divs[k]);
+            else { hi = spi_frame_ticks(divs[k]); break; }
+        }
+        need_cost[i] = max_frame_cost(i ? reduced.kept : events, limit, lo, hi);
+    });
+
+    // Per-frame detail at the chosen divider
+    std::vector<FrameBudget> frames(num_frames);
+    const uint64_t cost = spi_frame_ticks(spi_div);
+    const BusResult at_div = simulate_bus(events, cost, limit, frame_ticks, &frames);
+    for (size_t i = 0; i < events.size(); i++) {
+        if (reduced.dropped[i]) frames[events[i].clk_tick / frame_ticks].dropped++;
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    // Writes per frame
+    std::vector<uint32_t> per_frame(num_frames);
+    size_t busiest = 0;
+    for (size_t f = 0; f < num_frames; f++) {
+        per_frame[f] = frames[f].writes;
+        if (frames[f].writes > frames[busiest].writes) busiest = f;
+    }
+    std::vector<uint32_t> sorted = per_frame;
+    std::nth_element(sorted.begin(), sorted.begin() + num_frames * 99 / 100, sorted.end());
+
+    TableWriter<uint32_t, double, uint32_t, uint32_t, uint32_t, double, double> frame_file;
+    if (!frame_file.open("tmp/spi_budget_frames",
+                         {"frame", "time_s", "writes", "dropped", "burst", "busy_pct", "max_slip_us"}, csv)) {
+        std::cerr << "[TB] Error: Could not open " << frame_file.filename() << std::endl;
+        return 1;
+    }
+    for (size_t f = 0; f < num_frames; f++) {
+        const auto& fb = frames[f];
+        frame_file.row(f, (double)f * frame_ticks / CLK_FREQ_HZ, fb.writes, fb.dropped, fb.burst,
+                       100.0 * fb.busy / frame_ticks, ticks_to_us(fb.max_slip));
+    }
+    frame_file.close();
+
+    std::ofstream out("tmp/spi_budget.csv");
+    if (!out.is_open()) {
+        std::cerr << "[TB] Error: Could not open " << "tmp/spi_budget.csv" << std::endl;
+        return 1;
+    }
+    out << "spi_div,sclk_mhz,write_us,max_slip_us,p99_slip_us,late_writes,late_frames,peak_burst,"
+           "peak_busy_pct,reduced_max_slip_us,reduced_late_frames\n";
+    for (size_t i = 0; i < divs.size(); i++) {
+        out << divs[i] << "," << CLK_FREQ_HZ / 1e6 / divs[i] << ","
+            << ticks_to_us(spi_frame_ticks(divs[i])) << "," << ticks_to_us(full[i].max_slip) << ","
+            << ticks_to_us(full[i].p99_slip) << "," << full[i].late_writes << ","
+            << full[i].late_frames << "," << full[i].peak_burst << "," << 100.0 * full[i].peak_busy << ","
+            << ticks_to_us(lean[i].max_slip) << "," << lean[i].late_frames << "\n";
+    }
+    out.close();
+
+    const double duration = (double)events.back().clk_tick / CLK_FREQ_HZ;
+    const uint64_t dropped = events.size() - reduced.kept.size();
+
+    std::printf("[TB] %zu writes over %.1f s, %zu frames of %.1f ms\n", events.size(), duration,
+                num_frames, 1e3 * frame_ticks / CLK_FREQ_HZ);
+    std::printf("[TB] Writes per frame: mean %.1f, p99 %u, max %u (frame %zu at %.2f s)\n",
+                (double)events.size() / num_frames, sorted[num_frames * 99 / 100],
+                frames[busiest].writes, busiest, (double)busiest * frame_ticks / CLK_FREQ_HZ);
+    std::printf("[TB] Densest sample period: %zu writes at %.4f s\n", peak_win,
+                (double)events[peak_at].clk_tick / CLK_FREQ_HZ);
+    std::printf("[TB] Redundant: %llu overwritten before the next sample, %llu same value, "
+                "%llu unmapped: %llu writes (%.1f %%) can be dropped\n",
+                (unsigned long long)reduced.overwritten, (unsigned long long)reduced.same_value,
+                (unsigned long long)reduced.unmapped, (unsigned long long)dropped,
+                100.0 * dropped / events.size());
+
+    std::printf("\n[TB] spi_div  SCLK MHz  write us  max slip us  p99 slip us  late writes  "
+                "late frames  burst  busy %%  | reduced: max slip us  late frames\n");
+    for (size_t i = 0; i < divs.size(); i++) {
+        const auto& r = full[i];
+        std::printf("[TB] %7d %9.2f %9.2f %12.1f %12.1f %12llu %12llu %6u %7.1f  | %20.1f %12llu\n",
+                    divs[i], CLK_FREQ_HZ / 1e6 / divs[i], ticks_to_us(spi_frame_ticks(divs[i])),
+                    ticks_to_us(r.max_slip), ticks_to_us(r.p99_slip),
+                    (unsigned long long)r.late_writes, (unsigned long long)r.late_frames,
+                    r.peak_burst, 100.0 * r.peak_busy,
+                    ticks_to_us(lean[i].max_slip), (unsigned long long)lean[i].late_frames);
+    }
+
+    std::printf("\n");
+    const char* label[2] = {"all writes", "redundant writes dropped"};
+    for (int i = 0; i < 2; i++) {
+        if (!need_cost[i]) {
+            std::printf("[TB] Max slip <= %.1f us (%s): not reachable, the 20-clock CS gap alone is too slow\n",
+                        slip_us, label[i]);
+            continue;
+        }
+        const int div = 2 * (int)((need_cost[i] - spi_frame_ticks(0)) / 33);
+        std::printf("[TB] Max slip <= %.1f us (%s): SCLK >= %.3f MHz, %.2f us per write",
+                    slip_us, label[i], cost_to_sclk_hz(need_cost[i]) / 1e6, ticks_to_us(need_cost[i]));
+        if (div >= 2) std::printf(", spi_div <= %d\n", div);
+        else          std::printf(", faster than spi_div=2\n");
+    }
+
+    std::printf("\n[TB] At spi_div=%d (%.2f us per write): %llu of %zu frames late, worst slip %.1f us\n",
+                spi_div, ticks_to_us(cost), (unsigned long long)at_div.late_frames, num_frames,
+                ticks_to_us(at_div.max_slip));
+    long logged = 0;
+    for (size_t f = 0; f < num_frames && logged < late_log; f++) {
+        if (frames[f].max_slip <= limit) continue;
+        std::printf("[TB]   frame %6zu at %8.3f s: %4u writes, burst %4u, max slip %8.1f us\n", f,
+                    (double)f * frame_ticks / CLK_FREQ_HZ, frames[f].writes, frames[f].burst,
+                    ticks_to_us(frames[f].max_slip));
+        logged++;
+    }
+
+    std::cout << "\n[TB] Finished in " << elapsed << " s" << std::endl;
+    std::cout << "[TB] Saved to tmp/spi_budget.csv and " << frame_file.filename() << std::endl;
+    return 0;
+}
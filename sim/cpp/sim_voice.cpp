@@ -0,0 +1,464 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  File: sim_voice.cpp
+//  Description: Verilator testbench for the multi-voice oscillator.
+//               Checks the bit-exact oscillator model against the RTL on all
+//               three voice slots with random settings, sync and ring mod.
+//               With +osc_sweep, measures pitch and aliasing for every FCW.
+//
+//  Author:
+//    - Andreas Pedersen
+//
+//-------------------------------------------------------------------------------------------------
+
+#include "sim_common.h"
+#include "sim_dsp.h"
+#include "sim_model.h"
+#include "Vtb_voice.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+const int PHASE_BITS = 19;
+const int MAX_FCW    = 0xFFFF;
+
+// Process one voice slot: start_i until ready_o, then back to idle
+void run_voice(const std::unique_ptr<VerilatedContext>& ctx,
+               const std::unique_ptr<Vtb_voice>& top, int voice) {
+    top->act_voice_i = voice;
+    top->start_i = 1;
+    tick(ctx, top);
+    top->start_i = 0;
+
+    int cycles = 0;
+    while (!top->ready_o && cycles < 100) {
+        tick(ctx, top);
+        cycles++;
+    }
+}
+
+/**
+ * @brief Check the oscillator model against the RTL on all three voice slots.
+ *
+ * Each slot gets its own random FCW, pulse width, waveform (including
+ * invalid selections), sync and ring mod, changed every few hundred samples.
+ * wave_o, phase and LFSR are compared after every voice update, at the
+ * point where the controller reads the wave.
+ */
+bool check_voice_model(const std::unique_ptr<VerilatedContext>& ctx,
+                       const std::unique_ptr<Vtb_voice>& top,
+                       uint32_t seed, uint64_t num_samples) {
+    top->clk_i       = 0;
+    top->rst_ni      = 0;
+    top->start_i     = 0;
+    top->act_voice_i = 0;
+    top->sync_i      = 0;
+    top->ring_mod_i  = 0;
+    for (int i = 0; i < 5; i++) tick(ctx, top);
+    top->rst_ni = 1;
+    for (int i = 0; i < 5; i++) tick(ctx, top);
+
+    OscillatorModel osc[3];
+    uint32_t lfsr = seed;
+    auto rnd = [&]() { lfsr = lfsr * 1664525u + 1013904223u; return lfsr >> 16; };
+
+    uint16_t fcw[3] = {}, pw[3] = {};
+    int      sel[3] = {};
+    bool     sync[3] = {}, ring[3] = {};
+
+    for (uint64_t n = 0; n < num_samples; n++) {
+        for (int v = 0; v < 3; v++) {
+            if (n == 0 || rnd() % 300 == 0) {
+                fcw[v]  = rnd() >> (rnd() % 16);    // Log-spread over the 16-bit range
+                pw[v]   = rnd() & 0xFFF;
+                sel[v]  = (rnd() % 8) ? 1 << (rnd() % 4) : rnd() & 0xF;
+                sync[v] = rnd() % 4 == 0;
+                ring[v] = rnd() % 4 == 0;
+            }
+
+            top->freq_word_i = fcw[v];
+            top->pw_word_i   = pw[v];
+            top->wave_sel_i  = sel[v];
+            top->sync_i      = sync[v];
+            top->ring_mod_i  = ring[v];
+            run_voice(ctx, top, v);
+
+            const OscillatorModel& prev = osc[(v + 2) % 3];
+            osc[v].write(fcw[v], sync[v], prev);
+            int16_t expect = osc[v].wave(fcw[v], pw[v], sel[v], sync[v], ring[v], prev);
+            int16_t rtl    = (int16_t)wrap_signed<10>(top->wave_o);
+
+            if (rtl != expect || top->phase_o != osc[v].phase || top->lfsr_o != osc[v].lfsr) {
+                std::fprintf(stderr, "[TB] Model mismatch: seed %u sample %llu voice %d "
+                             "(fcw %04X pw %03X sel %X sync %d ring %d): "
+                             "RTL wave %d phase %05X lfsr %06X, model wave %d phase %05X lfsr %06X\n",
+                             seed, (unsigned long long)n, v, fcw[v], pw[v], sel[v], sync[v], ring[v],
+                             rtl, top->phase_o, top->lfsr_o, expect, osc[v].phase, osc[v].lfsr);
+                return false;
+            }
+            tick(ctx, top);
+        }
+    }
+    return true;
+}
+
+//=============================================================================
+// Pitch and Aliasing Sweep (+osc_sweep)
+//=============================================================================
+
+struct OscWave {
+    const char* name;
+    int         sel;
+    uint16_t    pw;
+};
+
+const OscWave OSC_WAVES[] = {
+    {"tri",      0b0001, 0},
+    {"saw",      0b0010, 0},
+    {"pulse50",  0b0100, 0x800},
+    {"pulse25",  0b0100, 0x400},
+    {"pulse6",   0b0100, 0x100},
+};
+const int NUM_OSC_WAVES = sizeof(OSC_WAVES) / sizeof(OSC_WAVES[0]);
+
+// Reference pitches for the printed aliasing table
+const int ALIAS_NOTES[] = {33, 45, 57, 69, 81, 93, 105};   // A1 .. A7
+
+const char* const NOTE_NAMES[12] = {
+    "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"
+};
+
+inline double fcw_to_hz(double fcw) {
+    return fcw * SAMPLE_RATE_HZ / (double)(1 << PHASE_BITS);
+}
+
+inline double cents(double f, double ref) {
+    return 1200.0 * std::log2(f / ref);
+}
+
+inline double to_db(double p) {
+    return 10.0 * std::log10(std::max(p, 1e-30));
+}
+
+/**
+ * @brief Harmonic power of one waveform sampled at a phase step of 2^k.
+ *
+ * With FCW = 2^k * F' (F' odd) the phase visits every multiple of 2^k once
+ * per period of N = 2^(19-k) samples, so one period of the output is a
+ * permutation of this table and harmonic h lands in bin h * F' mod N. The
+ * harmonics with h * F' > N/2 fold back below Nyquist as aliases. Suffix
+ * sums and maxima over h give the alias power of any F' in O(1).
+ */
+struct HarmonicTable {
+    double              fund = 0.0;     // Power of harmonic 1
+    std::vector<double> sum_from;       // Sum of harmonics h..N/2
+    std::vector<double> max_from;       // Largest harmonic in h..N/2
+
+    void build(const OscWave& w, int k) {
+        const size_t n = (size_t)1 << (PHASE_BITS - k);
+        std::vector<double> x(n);
+        for (size_t j = 0; j < n; j++) x[j] = osc_wave(w, (uint32_t)(j << k));
+        std::vector<double> p = power_spectrum(x, std::vector<double>(n, 1.0));
+
+        fund = p[1];
+        sum_from.assign(n / 2 + 2, 0.0);
+        max_from.assign(n / 2 + 2, 0.0);
+        for (size_t h = n / 2; h >= 1; h--) {
+            sum_from[h] = sum_from[h + 1] + p[h];
+            max_from[h] = std::max(max_from[h + 1], p[h]);
+        }
+    }
+
+    static double osc_wave(const OscWave& w, uint32_t phase) {
+        switch (w.sel) {
+            case 0b0001: return OscillatorModel::tri(phase, (phase >> 18) & 1);
+            case 0b0010: return OscillatorModel::saw(phase);
+            default:     return OscillatorModel::pulse(phase, w.pw);
+        }
+    }
+};
+
+struct AliasResult {
+    double   f0_hz     = 0.0;
+    uint32_t harmonics = 0;     // Harmonics below Nyquist
+    double   alias_dbc = 0.0;   // Total alias power relative to the fundamental
+    double   spur_dbc  = 0.0;   // Largest single alias relative to the fundamental
+};
+
+AliasResult alias_from_table(const std::vector<HarmonicTable>& tables, uint16_t fcw) {
+    const int      k    = __builtin_ctz(fcw);
+    const uint32_t odd  = fcw >> k;
+    const uint32_t half = 1u << (PHASE_BITS - k - 1);
+    const HarmonicTable& t = tables[k];
+
+    AliasResult r;
+    r.f0_hz     = fcw_to_hz(fcw);
+    r.harmonics = half / odd;
+    r.alias_dbc = to_db(t.sum_from[r.harmonics + 1] / t.fund);
+    r.spur_dbc  = to_db(t.max_from[r.harmonics + 1] / t.fund);
+    return r;
+}
+
+/**
+ * @brief Measure one FCW directly: run the model for one period and FFT it.
+ *
+ * Used to verify the table shortcut. Bins that are not a harmonic of the
+ * fundamental are aliases.
+ */
+AliasResult alias_from_model(const OscWave& w, uint16_t fcw, uint32_t& peak_bin) {
+    const int      k   = __builtin_ctz(fcw);
+    const uint32_t odd = fcw >> k;
+    const size_t   n   = (size_t)1 << (PHASE_BITS - k);
+
+    OscillatorModel osc;
+    std::vector<double> x(n);
+    for (size_t i = 0; i < n; i++) {
+        osc.write(fcw, false, osc);
+        x[i] = osc.wave(fcw, w.pw, w.sel, false, false, osc);
+    }
+    std::vector<double> p = power_spectrum(x, std::vector<double>(n, 1.0));
+
+    std::vector<bool> harmonic(n / 2 + 1, false);
+    uint32_t num_harmonics = 0;
+    for (uint64_t h = 1; h * odd <= n / 2; h++) {
+        harmonic[h * odd] = true;
+        num_harmonics++;
+    }
+
+    double alias = 0.0, spur = 0.0;
+    peak_bin = 1;
+    for (size_t m = 1; m <= n / 2; m++) {
+        if (p[m] > p[peak_bin]) peak_bin = m;
+        if (harmonic[m]) continue;
+        alias += p[m];
+        spur = std::max(spur, p[m]);
+    }
+
+    AliasResult r;
+    r.f0_hz     = peak_bin * (double)SAMPLE_RATE_HZ / n;
+    r.harmonics = num_harmonics;
+    r.alias_dbc = to_db(alias / p[odd]);
+    r.spur_dbc  = to_db(spur / p[odd]);
+    return r;
+}
+
+struct NoiseResult {
+    double   clock_hz = 0.0;    // Measured LFSR clock rate
+    uint32_t period   = 0;      // Samples until phase[9:0] repeats
+};
+
+// The LFSR clocks on rising edges of phase bit 9, which only depends on
+// phase[9:0]; that repeats after 1024 / gcd(FCW, 1024) samples
+NoiseResult measure_noise(uint16_t fcw) {
+    NoiseResult r;
+    r.period = 1024u >> std::min(__builtin_ctz(fcw), 10);
+
+    OscillatorModel osc;
+    uint32_t clocks = 0;
+    for (uint32_t i = 0; i < r.period; i++) {
+        uint32_t lfsr = osc.lfsr;
+        osc.write(fcw, false, osc);
+        clocks += osc.lfsr != lfsr;
+    }
+    r.clock_hz = (double)clocks * SAMPLE_RATE_HZ / r.period;
+    return r;
+}
+
+int run_osc_sweep(int argc, char** argv) {
+    unsigned threads      = sim_threads(argc, argv);
+    uint64_t check_samples = get_plusarg_int(argc, argv, "check_samples", 20000);
+    int      check_fcws   = (int)get_plusarg_int(argc, argv, "check_fcws", 16);
+    bool     csv          = has_plusarg(argc, argv, "csv");
+
+    std::cout << "[TB] Oscillator Pitch and Aliasing Sweep (" << threads << " threads)" << std::endl;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    // Verify the model on the RTL first, one model instance per thread
+    const unsigned NUM_CHECKS = std::max(4u, threads);
+    const bool check_ok = check_model_parallel(NUM_CHECKS, threads, [&](size_t i) {
+        const std::unique_ptr<VerilatedContext> ctx{new VerilatedContext};
+        ctx->traceEverOn(false);
+        const std::unique_ptr<Vtb_voice> top{new Vtb_voice{ctx.get(), "TOP"}};
+        const bool ok = check_voice_model(ctx, top, check_seed(i), check_samples);
+        top->final();
+        return ok;
+    });
+    if (!check_ok) return 1;
+    std::cout << "[TB] Model matches RTL on all 3 voice slots ("
+              << NUM_CHECKS * check_samples << " samples)" << std::endl;
+
+    // Harmonic tables: one per waveform and power-of-two factor of the FCW
+    const int NUM_K = 16;
+    std::vector<std::vector<HarmonicTable>> tables(NUM_OSC_WAVES, std::vector<HarmonicTable>(NUM_K));
+    parallel_for(NUM_OSC_WAVES * NUM_K, threads, [&](size_t i, unsigned) {
+        tables[i / NUM_K][i % NUM_K].build(OSC_WAVES[i / NUM_K], i % NUM_K);
+    });
+
+    // Verify the shortcut against a direct FFT of the model output
+    std::vector<uint16_t> spot = {1, 3, 0x8000, 0x7FFF, MAX_FCW};
+    uint32_t lcg = 0xC0FFEEu;
+    while ((int)spot.size() < check_fcws) {
+        lcg = lcg * 1664525u + 1013904223u;
+        uint16_t f = (lcg >> 16) >> ((lcg >> 8) % 12);
+        if (f) spot.push_back(f);
+    }
+    std::atomic<int> spot_fail{0};
+    parallel_for(NUM_OSC_WAVES * spot.size(), threads, [&](size_t i, unsigned) {
+        const int      w   = i / spot.size();
+        const uint16_t fcw = spot[i % spot.size()];
+        uint32_t peak_bin;
+        AliasResult d = alias_from_model(OSC_WAVES[w], fcw, peak_bin);
+        AliasResult t = alias_from_table(tables[w], fcw);
+
+        auto same_db = [](double a, double b) {
+            return std::fabs(a - b) < 0.01 || (a < -150.0 && b < -150.0);
+        };
+        if (d.f0_hz != t.f0_hz || d.harmonics != t.harmonics ||
+            !same_db(d.alias_dbc, t.alias_dbc) || !same_db(d.spur_dbc, t.spur_dbc)) {
+            std::fprintf(stderr, "[TB] Shortcut mismatch: %s fcw %04X: FFT f0 %.4f Hz alias %.3f "
+                         "spur %.3f dBc, table f0 %.4f Hz alias %.3f spur %.3f dBc\n",
+                         OSC_WAVES[w].name, fcw, d.f0_hz, d.alias_dbc, d.spur_dbc,
+                         t.f0_hz, t.alias_dbc, t.spur_dbc);
+            spot_fail++;
+        }
+    });
+    if (spot_fail) return 1;
+    std::cout << "[TB] Harmonic tables match a direct FFT of the model on "
+              << spot.size() << " FCWs per waveform" << std::endl;
+
+    // Every FCW, every waveform
+    std::vector<std::vector<AliasResult>> alias(NUM_OSC_WAVES, std::vector<AliasResult>(MAX_FCW + 1));
+    std::vector<NoiseResult> noise(MAX_FCW + 1);
+    parallel_for(MAX_FCW, threads, [&](size_t i, unsigned) {
+        const uint16_t fcw = i + 1;
+        for (int w = 0; w < NUM_OSC_WAVES; w++) alias[w][fcw] = alias_from_table(tables[w], fcw);
+        noise[fcw] = measure_noise(fcw);
+    });
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    TableWriter<uint16_t, uint8_t, double, uint32_t, double, double> alias_file;
+    if (!alias_file.open("tmp/osc_alias", {"fcw", "wave", "f0_hz", "harmonics", "alias_dbc", "spur_dbc"}, csv)) {
+        std::cerr << "[TB] Error: Could not open " << alias_file.filename() << std::endl;
+        return 1;
+    }
+    for (int w = 0; w < NUM_OSC_WAVES; w++) {
+        for (uint32_t f = 1; f <= MAX_FCW; f++) {
+            const auto& r = alias[w][f];
+            alias_file.row(f, w, r.f0_hz, r.harmonics, r.alias_dbc, r.spur_dbc);
+        }
+    }
+    alias_file.close();
+
+    TableWriter<uint16_t, double, double, uint32_t> noise_file;
+    if (!noise_file.open("tmp/osc_noise", {"fcw", "clock_hz", "ideal_hz", "period"}, csv)) {
+        std::cerr << "[TB] Error: Could not open " << noise_file.filename() << std::endl;
+        return 1;
+    }
+    for (uint32_t f = 1; f <= MAX_FCW; f++) {
+        noise_file.row(f, noise[f].clock_hz, fcw_to_hz(f) * 512.0, noise[f].period);
+    }
+    noise_file.close();
+
+    // Note map: the truncating calc_fcw() against the nearest FCW
+    struct NoteFcw {
+        int      midi;
+        double   freq;
+        uint16_t trunc, best;
+    };
+    std::vector<NoteFcw> notes;
+    for (int m = 0; m < 128; m++) {
+        double   f    = 440.0 * std::pow(2.0, (m - 69) / 12.0);
+        uint64_t best = std::llround(f * (1 << PHASE_BITS) / SAMPLE_RATE_HZ);
+        if (best > MAX_FCW) break;
+        notes.push_back({m, f, calc_fcw(f), (uint16_t)best});
+    }
+
+    std::ofstream nf("tmp/osc_notes.csv");
+    if (!nf.is_open()) {
+        std::cerr << "[TB] Error: Could not open " << "tmp/osc_notes.csv" << std::endl;
+        return 1;
+    }
+    nf << "midi,note,freq_hz,calc_fcw,calc_hz,calc_cents,fcw,fcw_hz,fcw_cents\n";
+    for (const auto& n : notes) {
+        nf << n.midi << "," << NOTE_NAMES[n.midi % 12] << (n.midi / 12 - 1) << "," << n.freq << ","
+           << n.trunc << "," << fcw_to_hz(n.trunc) << "," << cents(fcw_to_hz(n.trunc), n.freq) << ","
+           << n.best << "," << fcw_to_hz(n.best) << "," << cents(fcw_to_hz(n.best), n.freq) << "\n";
+    }
+    nf.close();
+
+    // Pitch error per octave
+    std::printf("\n[TB] octave   max |cents| calc_fcw   max |cents| nearest   FCW step (cents)\n");
+    for (int oct = -1; oct <= 8; oct++) {
+        double worst_trunc = 0.0, worst_best = 0.0, step = 0.0;
+        bool any = false;
+        for (const auto& n : notes) {
+            if (n.midi / 12 - 1 != oct) continue;
+            any = true;
+            double ct = n.trunc ? std::fabs(cents(fcw_to_hz(n.trunc), n.freq)) : INFINITY;
+            worst_trunc = std::max(worst_trunc, ct);
+            worst_best  = std::max(worst_best, std::fabs(cents(fcw_to_hz(n.best), n.freq)));
+            step        = std::max(step, cents(n.best + 1.0, n.best));
+        }
+        if (any) std::printf("[TB] %6d %21.2f %21.2f %18.2f\n", oct, worst_trunc, worst_best, step);
+    }
+
+    // Aliasing at reference pitches
+    std::printf("\n[TB] alias / worst spur (dBc) at the nearest FCW\n[TB] %-8s", "wave");
+    for (int m : ALIAS_NOTES) std::printf("  %14s", (std::string("A") + std::to_string(m / 12 - 1)).c_str());
+    std::printf("\n");
+    for (int w = 0; w < NUM_OSC_WAVES; w++) {
+        std::printf("[TB] %-8s", OSC_WAVES[w].name);
+        for (int m : ALIAS_NOTES) {
+            const auto& r = alias[w][notes[m].best];
+            std::printf("  %6.1f / %5.1f", r.alias_dbc, r.spur_dbc);
+        }
+        std::printf("\n");
+    }
+
+    // Noise clock: ideal rate is 512 LFSR clocks per phase wrap
+    uint32_t frozen = 0, first_slow = 0;
+    for (uint32_t f = 1; f <= MAX_FCW; f++) {
+        if (noise[f].clock_hz == 0.0) frozen++;
+        if (!first_slow && noise[f].clock_hz < 0.99 * fcw_to_hz(f) * 512.0) first_slow = f;
+    }
+    std::printf("\n[TB] Noise: LFSR clock falls behind FCW * Fs / 1024 from FCW %u (%.0f Hz), "
+                "frozen for %u FCWs (multiples of 1024)\n",
+                first_slow, fcw_to_hz(first_slow), frozen);
+
+    std::cout << "\n[TB] Finished in " << elapsed << " s" << std::endl;
+    std::cout << "[TB] Saved to " << alias_file.filename() << ", " << noise_file.filename()
+              << " and tmp/osc_notes.csv" << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    Verilated::mkdir("logs");
+    const std::unique_ptr<VerilatedContext> contextp{new VerilatedContext};
+    contextp->commandArgs(argc, argv);
+    contextp->traceEverOn(has_plusarg(argc, argv, "trace"));
+    const std::unique_ptr<Vtb_voice> top{new Vtb_voice{contextp.get(), "TOP"}};
+
+    if (has_plusarg(argc, argv, "osc_sweep")) {
+        top->final();
+        return run_osc_sweep(argc, argv);
+    }
+
+    uint32_t seed    = (uint32_t)get_plusarg_int(argc, argv, "seed", 1);
+    uint64_t samples = get_plusarg_int(argc, argv, "samples", 50000);
+
+    std::cout << "[TB] Multi-Voice Oscillator Testbench" << std::endl;
+    std::cout << "[TB] Checking model against RTL (seed " << seed << ", "
+              << samples << " samples)..." << std::endl;
+
+    bool ok = check_voice_model(contextp, top, seed, samples);
+    top->final();
+
+    if (ok) std::cout << "[TB] Model matches RTL on all 3 voice slots" << std::endl;
+    std::cout << "[TB] Simulation finished. Time simulated: "
+              << contextp->time() * 1e-9 << "s" << std::endl;
+    report_stats(argc, argv, contextp, "voice");
+    return ok ? 0 : 1;
+}
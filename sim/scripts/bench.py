@@ -0,0 +1,189 @@
+"""
+Runs the fixed simulator benchmark workloads and reports throughput.
+
+Each workload runs a prebuilt testbench binary with +stats=<json> (SimStats
+in sim_common.h) and the results are merged into one JSON report. With
+--baseline, throughput and memory are compared against a stored report and
+the script exits non-zero on a regression.
+"""
+
+import argparse
+import json
+import os
+import platform
+import random
+import subprocess
+import sys
+import time
+
+SIM_DIR    = '..'
+STORM_FILE = 'tmp/bench_spi_storm.txt'
+
+CLK_FREQ_HZ     = 50_000_000
+TICKS_PER_FRAME = CLK_FREQ_HZ // 50   # 50 Hz player frames
+
+# (name, binary under obj_dir, arguments)
+WORKLOADS = [
+    ('mult',          'mult/Vtb_mult',               []),
+    ('spi',           'spi/Vtb_spi',                 []),
+    ('envelope',      'envelope/Vtb_envelope',       []),
+    ('svf',           'svf/Vtb_svf',                 []),
+    ('delta_sigma',   'delta_sigma/Vtb_delta_sigma', []),
+    ('tt6581_song',   'tt6581/Vtb_tt6581',           ['song']),
+    ('player_monty',  'tt6581/Vtb_tt6581',           ['player', '+max_sec=30']),
+    ('spi_storm',     'tt6581/Vtb_tt6581',           ['player', '+stimulus=' + STORM_FILE]),
+]
+
+PHASES = ['eval', 'spi', 'io', 'setup']
+
+def write_storm(path, frames=50, writes_per_frame=4000, seed=1):
+    """
+    Write a stimulus file of frames * 20 ms with a write burst per frame.
+
+    All voices are gated on and routed through the filter, then every frame
+    starts with a back-to-back burst of random voice and filter register
+    writes. At the player's SPI_CLK_DIV = 2 a write takes 53 clocks, so a
+    burst of 4000 writes keeps the bus busy for about 21 % of the
+    1,000,000-clock frame, and the rest of the frame is model evaluation.
+    """
+    rng = random.Random(seed)
+    setup = [
+        (0x05, 0x00), (0x06, 0xF0), (0x04, 0x41),   # Voice 1: pulse, gate
+        (0x0C, 0x00), (0x0D, 0xF0), (0x0B, 0x21),   # Voice 2: saw, gate
+        (0x13, 0x00), (0x14, 0xF0), (0x12, 0x11),   # Voice 3: triangle, gate
+        (0x19, 0x39), (0x1A, 0xFF),                 # Filter: V1-V3, LP, volume
+    ]
+    # Pitch, pulse width and filter registers; CTRL is left alone so the
+    # voices keep sounding through the storm
+    targets = [b + r for b in (0x00, 0x07, 0x0E) for r in (0, 1, 2, 3)] + [0x15, 0x16, 0x17, 0x18]
+
+    with open(path, 'w') as f:
+        f.write('# TT6581 Stimulus File\n')
+        f.write('# Title: SPI write storm (bench.py)\n')
+        f.write('# Format: clk_tick addr data\n')
+        for addr, data in setup:
+            f.write(f'1000 0x{addr:02X} 0x{data:02X}\n')
+        for frame in range(1, frames + 1):
+            tick = frame * TICKS_PER_FRAME
+            for _ in range(writes_per_frame):
+                f.write(f'{tick} 0x{rng.choice(targets):02X} 0x{rng.randrange(256):02X}\n')
+
+def run_workload(name, binary, args):
+    """
+    Run one workload and return its SimStats record.
+    """
+    stats_path = f'tmp/bench_{name}.json'
+    log_path   = f'tmp/bench_{name}.log'
+    cmd = [os.path.join('obj_dir', binary), f'+stats={stats_path}'] + args
+
+    full_stats = os.path.join(SIM_DIR, stats_path)
+    if os.path.exists(full_stats):
+        os.remove(full_stats)
+
+    with open(os.path.join(SIM_DIR, log_path), 'w') as log:
+        rc = subprocess.run(cmd, cwd=SIM_DIR, stdout=log, stderr=subprocess.STDOUT).returncode
+
+    if rc != 0 or not os.path.exists(full_stats):
+        print(f'[BENCH] {name} failed (exit {rc}), see {log_path}')
+        return None
+
+    with open(full_stats) as f:
+        return json.load(f)
+
+def print_results(results, baseline):
+    base = baseline['results'] if baseline else {}
+
+    print()
+    print(f"{'workload':<14}{'Mcyc/s':>9}{'x realtime':>12}{'RSS MB':>9}"
+          + ''.join(f'{p + " %":>9}' for p in PHASES)
+          + (f"{'vs base':>10}" if baseline else ''))
+    for name, r in results.items():
+        phases = r['phases']
+        total  = sum(phases.values()) or 1.0
+        line = (f"{name:<14}{r['cycles_per_sec'] / 1e6:>9.2f}{r['realtime_factor']:>12.4f}"
+                f"{r['peak_rss_kb'] / 1024:>9.1f}"
+                + ''.join(f'{100 * phases[p] / total:>9.1f}' for p in PHASES))
+        if name in base:
+            line += f"{100 * (r['cycles_per_sec'] / base[name]['cycles_per_sec'] - 1):>+9.1f}%"
+        print(line)
+    print()
+
+def compare(results, baseline, speed_tol, rss_tol):
+    """
+    Return a list of regression messages against a baseline report.
+    """
+    regressions = []
+    for name, r in results.items():
+        b = baseline['results'].get(name)
+        if b is None:
+            continue
+
+        speed = r['cycles_per_sec'] / b['cycles_per_sec']
+        if speed < 1 - speed_tol:
+            regressions.append(f'{name}: throughput {100 * (speed - 1):+.1f}% '
+                               f'({b["cycles_per_sec"] / 1e6:.2f} -> {r["cycles_per_sec"] / 1e6:.2f} Mcyc/s)')
+
+        rss = r['peak_rss_kb'] / b['peak_rss_kb']
+        if rss > 1 + rss_tol:
+            regressions.append(f'{name}: peak RSS {100 * (rss - 1):+.1f}% '
+                               f'({b["peak_rss_kb"] / 1024:.1f} -> {r["peak_rss_kb"] / 1024:.1f} MB)')
+    return regressions
+
+def main():
+    parser = argparse.ArgumentParser(description='TT6581 simulator benchmark')
+    parser.add_argument('--out', default='../tmp/bench.json', help='Merged JSON report')
+    parser.add_argument('--baseline', help='Stored report to compare against')
+    parser.add_argument('--only', nargs='+', help='Run only these workloads')
+    parser.add_argument('--repeat', type=int, default=1, help='Runs per workload, fastest is kept')
+    parser.add_argument('--speed-tol', type=float, default=0.10, help='Allowed throughput drop')
+    parser.add_argument('--rss-tol', type=float, default=0.20, help='Allowed peak RSS growth')
+    args = parser.parse_args()
+
+    # Read the baseline first: it may be the same file as --out
+    baseline = None
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+    workloads = [w for w in WORKLOADS if not args.only or w[0] in args.only]
+
+    if any(STORM_FILE in a for _, _, wargs in workloads for a in wargs):
+        write_storm(os.path.join(SIM_DIR, STORM_FILE))
+
+    results = {}
+    for name, binary, wargs in workloads:
+        print(f'[BENCH] {name}: {binary} {" ".join(wargs)}')
+        best = None
+        for _ in range(args.repeat):
+            r = run_workload(name, binary, wargs)
+            if r is None:
+                sys.exit(1)
+            if best is None or r['cycles_per_sec'] > best['cycles_per_sec']:
+                best = r
+        results[name] = best
+
+    report = {
+        'date':    time.strftime('%Y-%m-%dT%H:%M:%S'),
+        'host':    platform.node(),
+        'cpu':     platform.processor() or platform.machine(),
+        'results': results,
+    }
+    with open(args.out, 'w') as f:
+        json.dump(report, f, indent=2)
+
+    print_results(results, baseline)
+    print(f'[BENCH] Saved to {args.out}')
+
+    if baseline:
+        regressions = compare(results, baseline, args.speed_tol, args.rss_tol)
+        if baseline.get('host') != report['host']:
+            print(f"[BENCH] Note: baseline was recorded on {baseline.get('host')}")
+        if regressions:
+            print('[BENCH] Regressions against ' + args.baseline + ':')
+            for r in regressions:
+                print('  ' + r)
+            sys.exit(1)
+        print('[BENCH] No regressions against ' + args.baseline)
+
+if __name__ == '__main__':
+    main()
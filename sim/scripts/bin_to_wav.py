@@ -1,8 +1,12 @@
 """
 Converts binary PDM data to audio file.
+
+Usage: bin_to_wav.py [pdm_file [wav_file]]; the plot is saved next to the
+WAV file with a .png extension.
 """
 
 import os
+import sys
 import numpy as np
 import matplotlib.pyplot as plt
 from scipy.signal import butter, bessel, sosfilt
@@ -15,8 +19,8 @@ TARGET_RATE = 50_000      # Target audio sample rate
 FILT_ORDER  = 4           # Filter order
 FILT_CUTOFF = 20_000      # Low-pass cutoff
 
-def main():
-    file_size = os.path.getsize(PDM_FILE)
+def main(pdm_file=PDM_FILE, output_wav=OUTPUT_WAV):
+    file_size = os.path.getsize(pdm_file)
     total_pdm = file_size * 8  # each byte -> 8 bits
     duration = total_pdm / PDM_RATE
     print(f"PDM samples: {total_pdm:,} ({duration:.2f}s at {PDM_RATE/1e6:.0f} MHz)")
@@ -31,7 +35,7 @@ def main():
     phase = 0  # decimation phase carried across chunks
 
     samples_done = 0
-    with open(PDM_FILE, 'rb') as f:
+    with open(pdm_file, 'rb') as f:
         while True:
             raw = np.frombuffer(f.read(CHUNK_BYTES), dtype=np.uint8)
             if len(raw) == 0:
@@ -61,8 +65,8 @@ def main():
         audio = audio / peak
 
     # Save WAV
-    wavfile.write(OUTPUT_WAV, TARGET_RATE, audio.astype(np.float32))
-    print(f"Saved {OUTPUT_WAV} ({len(audio):,} samples, {len(audio)/TARGET_RATE:.2f}s)")
+    wavfile.write(output_wav, TARGET_RATE, audio.astype(np.float32))
+    print(f"Saved {output_wav} ({len(audio):,} samples, {len(audio)/TARGET_RATE:.2f}s)")
 
     # plot
     t = np.arange(len(audio)) / TARGET_RATE
@@ -85,7 +89,7 @@ def main():
     axes[1].grid(linestyle='--', alpha=0.5)
 
     plt.tight_layout()
-    plt.savefig('../out/audio.png', dpi=400)
+    plt.savefig(os.path.splitext(output_wav)[0] + '.png', dpi=400)
 
 if __name__ == "__main__":
-    main()
\ No newline at end of file
+    main(*sys.argv[1:3])
\ No newline at end of file
@@ -3,10 +3,11 @@ Plots TT6581 natural frequency response from bode testbench output.
 """
 
 import numpy as np
-import pandas as pd
 import matplotlib.pyplot as plt
 from scipy.signal import bessel, sosfilt
 
+from sim_io import load_table
+
 PDM_RATE    = 10_000_000   # 10 MHz PDM rate
 TARGET_RATE = 50_000       # 50 kHz audio rate (matches sim SAMPLE_RATE)
 DECIMATION  = PDM_RATE // TARGET_RATE  # 200
@@ -16,7 +17,7 @@ FILT_CUTOFF = 20_000       # low-pass for PDM reconstruction
 SETTLE_TIME = 0.05
 
 PDM_FILE = '../tmp/bode.bin'
-CSV_FILE = '../tmp/bode.csv'
+SCHED_FILE = '../tmp/bode'
 
 def pdm_to_audio(pdm_path):
     """
@@ -52,7 +53,7 @@ def plot_bode():
     audio = pdm_to_audio(PDM_FILE)
 
     # Read frequency schedule
-    sched = pd.read_csv(CSV_FILE)
+    sched = load_table(SCHED_FILE)
     freqs = sched["freq_hz"].to_numpy()
 
     # Trim settle period
@@ -2,11 +2,12 @@
 Parses envelope testbench output.
 """
 
-import pandas as pd
 import matplotlib.pyplot as plt
 
+from sim_io import load_table
+
 def main():
-    df = pd.read_csv('../tmp/envelope_output.csv')
+    df = load_table('../tmp/envelope_output')
 
     # prod_o = voice_signed * env_raw (0-255)
     # To get envelope-scaled voice: divide by 255
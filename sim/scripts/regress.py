@@ -0,0 +1,313 @@
+"""
+Audio regression runner.
+
+Renders a fixed corpus with the prebuilt testbench binaries and compares
+per-second content hashes of every output (PDM bitstreams and .npy tables)
+against stored goldens. Each workload runs in its own directory under
+tmp/regress, all of them in parallel. A workload whose binary, plusargs and
+stimulus are unchanged since its last run is not rendered again.
+
+On a mismatch the first differing second is compared against the reference
+render stored by --update, and the exact PDM bit or table row is reported
+with the register writes around it (+reg_log in the top-level benches).
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import shutil
+import subprocess
+import sys
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+
+SIM_DIR   = '..'
+RUN_DIR   = 'tmp/regress'
+REF_DIR   = 'tmp/regress/golden'
+STATE     = 'tmp/regress/state.json'
+
+CLK_FREQ_HZ    = 50_000_000
+PDM_RATE       = 10_000_000
+SAMPLE_RATE    = 50_000
+PDM_CHUNK      = PDM_RATE // 8      # bytes per second of PDM
+CYCLES_PER_DAC = CLK_FREQ_HZ // PDM_RATE
+
+# (name, binary under obj_dir, arguments, outputs)
+CORPUS = [
+    ('tt6581_song',  'tt6581/Vtb_tt6581', ['song', '+reg_log'], ['tmp/pdm_out.bin']),
+    ('player_monty', 'tt6581/Vtb_tt6581', ['player', '+reg_log'], ['tmp/player_pdm.bin']),
+    ('bode',         'tt6581/Vtb_tt6581', ['bode', '+reg_log'], ['tmp/bode.bin', 'tmp/bode.npy']),
+    ('svf',          'svf/Vtb_svf',       [], ['tmp/svf_out_lp.npy', 'tmp/svf_out_bp.npy',
+                                               'tmp/svf_out_hp.npy', 'tmp/svf_out_br.npy']),
+    ('envelope',     'envelope/Vtb_envelope',       [], ['tmp/envelope_output.npy']),
+    ('delta_sigma',  'delta_sigma/Vtb_delta_sigma', [], ['tmp/delta_sigma.bin']),
+    ('mult',         'mult/Vtb_mult',               [], []),
+    ('spi',          'spi/Vtb_spi',                 [], []),
+]
+
+def sim_path(*parts):
+    return os.path.join(SIM_DIR, *parts)
+
+def file_digest(h, path):
+    with open(path, 'rb') as f:
+        for block in iter(lambda: f.read(1 << 20), b''):
+            h.update(block)
+
+def run_key(binary, args):
+    """
+    Hash of everything a render depends on: the binary, its plusargs and
+    the stimulus files.
+    """
+    h = hashlib.sha256()
+    file_digest(h, sim_path('obj_dir', binary))
+    h.update(' '.join(args).encode())
+    stim_dir = sim_path('stimulus')
+    for name in sorted(os.listdir(stim_dir)):
+        file_digest(h, os.path.join(stim_dir, name))
+    return h.hexdigest()
+
+def output_data(path):
+    """
+    Raw bytes of an output as a uint8 array, and the bytes per second of
+    content: PDM files are hashed as-is, .npy tables from their data
+    section in rows of one second of samples.
+    """
+    if path.endswith('.npy'):
+        table = np.load(path, mmap_mode='r')
+        return table.view(np.uint8).reshape(-1), table.dtype.itemsize * SAMPLE_RATE
+    if os.path.getsize(path) == 0:
+        return np.zeros(0, dtype=np.uint8), PDM_CHUNK
+    return np.memmap(path, dtype=np.uint8, mode='r'), PDM_CHUNK
+
+def hash_output(path):
+    data, chunk = output_data(path)
+    hashes = [hashlib.blake2b(data[i:i + chunk].tobytes(), digest_size=8).hexdigest()
+              for i in range(0, len(data), chunk)]
+    return {'bytes': int(len(data)), 'chunk': chunk, 'hashes': hashes}
+
+def render(name, binary, args, outputs, force, update, state):
+    """
+    Render one workload, or reuse the previous result if nothing it depends
+    on has changed. With update the outputs are copied to the reference, so
+    a cached result is only reused while its run directory still has them.
+    Returns the state record.
+    """
+    if not os.path.exists(sim_path('obj_dir', binary)):
+        return {'key': None, 'rc': 127, 'outputs': {}, 'cached': False}
+
+    key = run_key(binary, args)
+    prev = state.get(name)
+    have_outputs = all(os.path.exists(sim_path(RUN_DIR, name, out)) for out in outputs)
+    if not force and prev and prev['key'] == key and (have_outputs or not update):
+        return dict(prev, cached=True)
+
+    run_dir = sim_path(RUN_DIR, name)
+    shutil.rmtree(run_dir, ignore_errors=True)
+    os.makedirs(os.path.join(run_dir, 'tmp'))
+    os.makedirs(os.path.join(run_dir, 'logs'))
+    os.symlink(os.path.abspath(sim_path('stimulus')), os.path.join(run_dir, 'stimulus'))
+
+    cmd = [os.path.abspath(sim_path('obj_dir', binary))] + args
+    with open(os.path.join(run_dir, 'run.log'), 'w') as log:
+        rc = subprocess.run(cmd, cwd=run_dir, stdout=log, stderr=subprocess.STDOUT).returncode
+
+    record = {'key': key, 'rc': rc, 'outputs': {}, 'cached': False}
+    for out in outputs:
+        path = os.path.join(run_dir, out)
+        if os.path.exists(path):
+            record['outputs'][out] = hash_output(path)
+    return record
+
+#==============================================================================
+# First-Divergence Locator
+#==============================================================================
+
+def first_diff(a, b):
+    """
+    Index of the first differing byte of two equal-length uint8 arrays, or
+    -1. The bulk of the compare runs on 64-bit words.
+    """
+    n = len(a) // 8 * 8
+    words = np.flatnonzero(a[:n].view(np.uint64) != b[:n].view(np.uint64))
+    if len(words):
+        base = int(words[0]) * 8
+        return base + int(np.flatnonzero(a[base:base + 8] != b[base:base + 8])[0])
+    tail = np.flatnonzero(a[n:] != b[n:])
+    return n + int(tail[0]) if len(tail) else -1
+
+def load_reg_log(name):
+    path = sim_path(RUN_DIR, name, 'tmp', 'reg_log.txt')
+    if not os.path.exists(path):
+        return None
+    events = []
+    with open(path) as f:
+        for line in f:
+            if line.startswith('#') or not line.strip():
+                continue
+            tick, addr, data = line.split()
+            events.append((int(tick), int(addr, 16), int(data, 16)))
+    return events
+
+def print_events(events, t, context_ms, limit=40):
+    if events is None:
+        return
+    lo = (t - context_ms / 1000) * CLK_FREQ_HZ
+    hi = (t + context_ms / 1000) * CLK_FREQ_HZ
+    near = [e for e in events if lo <= e[0] <= hi]
+    print(f'      register writes within {context_ms} ms: {len(near)}')
+    for tick, addr, data in near[:limit]:
+        print(f'        {tick / CLK_FREQ_HZ:.6f} s  tick {tick:>11}  0x{addr:02X} = 0x{data:02X}')
+    if len(near) > limit > 0:
+        print(f'        ... {len(near) - limit} more')
+
+def locate(name, out, cur, gold, context_ms):
+    """
+    Report where an output first diverges from its golden.
+    """
+    n = min(len(cur['hashes']), len(gold['hashes']))
+    sec = next((i for i in range(n) if cur['hashes'][i] != gold['hashes'][i]), n)
+    pdm = out.endswith('.bin')
+    events = load_reg_log(name)
+
+    if cur['bytes'] != gold['bytes']:
+        print(f"    {out}: {cur['bytes']} bytes, golden {gold['bytes']}")
+    print(f'    {out}: first differing second {sec} ({sec}-{sec + 1} s)')
+
+    ref = sim_path(REF_DIR, name, out)
+    if not os.path.exists(ref) or os.path.getsize(ref) == 0:
+        print(f'      no reference render in {REF_DIR}/{name}, run --update on a good build to store one')
+        print_events(events, sec + 0.5, 500, limit=0)
+        return
+
+    cur_path = sim_path(RUN_DIR, name, out)
+    if not os.path.exists(cur_path):
+        print(f'      {RUN_DIR}/{name} was removed, rerun with --force to locate the divergence')
+        return
+
+    a, chunk = output_data(cur_path)
+    b, _     = output_data(ref)
+    start = sec * chunk
+    a = np.ascontiguousarray(a[start:start + chunk])
+    b = np.ascontiguousarray(b[start:start + chunk])
+    m = min(len(a), len(b))
+    first = first_diff(a[:m], b[:m])
+    if first < 0:
+        print(f'      identical up to the end of the shorter output ({(start + m) / chunk:.6f} s)')
+        print_events(events, (start + m) / chunk, context_ms)
+        return
+
+    if pdm:
+        x   = int(a[first] ^ b[first])
+        bit = (start + first) * 8 + (8 - x.bit_length())
+        t   = bit / PDM_RATE
+        ndiff = int(np.unpackbits(a[:m] ^ b[:m]).sum())
+        print(f'      first differing PDM bit {bit} (t = {t:.7f} s, about tick {bit * CYCLES_PER_DAC}): '
+              f'got {int(np.unpackbits(a[first:first + 1])[bit % 8])}, '
+              f'golden {int(np.unpackbits(b[first:first + 1])[bit % 8])}; {ndiff} bits differ in this second')
+    else:
+        cur_t = np.load(cur_path, mmap_mode='r')
+        ref_t = np.load(ref, mmap_mode='r')
+        row = (start + first) // cur_t.dtype.itemsize
+        t   = float(cur_t['time_sec'][row]) if 'time_sec' in cur_t.dtype.names else row / SAMPLE_RATE
+        print(f'      first differing row {row} (t = {t:.6f} s)')
+        print(f'        got    {cur_t[row]}')
+        print(f'        golden {ref_t[row] if row < len(ref_t) else "(missing)"}')
+    print_events(events, t, context_ms)
+
+#==============================================================================
+# Main
+#==============================================================================
+
+def main():
+    parser = argparse.ArgumentParser(description='TT6581 audio regression')
+    parser.add_argument('--golden', default='../regress_golden.json', help='Stored golden hashes')
+    parser.add_argument('--update', action='store_true', help='Store the current renders as golden')
+    parser.add_argument('--only', nargs='+', help='Run only these workloads')
+    parser.add_argument('--force', action='store_true', help='Render even if nothing changed')
+    parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count(), help='Parallel renders')
+    parser.add_argument('--context-ms', type=float, default=2.0, help='Register writes listed around a divergence')
+    args = parser.parse_args()
+
+    # Without goldens there is nothing to compare against, so only --update may create them
+    golden = {}
+    if os.path.exists(args.golden):
+        with open(args.golden) as f:
+            golden = json.load(f)
+    elif not args.update:
+        print(f'[REGRESS] ERROR: no golden file {args.golden}, run `make regress_update` on a known-good build')
+        sys.exit(1)
+
+    os.makedirs(sim_path(RUN_DIR), exist_ok=True)
+    state = {}
+    if os.path.exists(sim_path(STATE)):
+        with open(sim_path(STATE)) as f:
+            state = json.load(f)
+
+    corpus = [w for w in CORPUS if not args.only or w[0] in args.only]
+    with ThreadPoolExecutor(max_workers=args.jobs) as pool:
+        jobs = {w[0]: pool.submit(render, *w, args.force, args.update, state) for w in corpus}
+        results = {name: job.result() for name, job in jobs.items()}
+
+    for name, r in results.items():
+        state[name] = {k: v for k, v in r.items() if k != 'cached'}
+    with open(sim_path(STATE), 'w') as f:
+        json.dump(state, f)
+
+    failed = False
+    print()
+    for name, binary, _, outputs in corpus:
+        r    = results[name]
+        note = ' (cached)' if r['cached'] else ''
+        secs = max((len(o['hashes']) for o in r['outputs'].values()), default=0)
+
+        if r['rc'] != 0 or len(r['outputs']) != len(outputs):
+            if r['rc'] == 127 and r['key'] is None:
+                print(f'[REGRESS] {name:<14} ERROR: obj_dir/{binary} not built')
+            else:
+                print(f'[REGRESS] {name:<14} ERROR{note}: exit {r["rc"]}, see {RUN_DIR}/{name}/run.log')
+            failed = True
+            continue
+
+        if args.update:
+            # Copy to a new directory first, so a failed copy keeps the old reference
+            golden[name] = r['outputs']
+            ref_dir = sim_path(REF_DIR, name)
+            new_dir = ref_dir + '.new'
+            shutil.rmtree(new_dir, ignore_errors=True)
+            for out in outputs:
+                os.makedirs(os.path.dirname(os.path.join(new_dir, out)), exist_ok=True)
+                shutil.copyfile(sim_path(RUN_DIR, name, out), os.path.join(new_dir, out))
+            shutil.rmtree(ref_dir, ignore_errors=True)
+            os.rename(new_dir, ref_dir)
+            print(f'[REGRESS] {name:<14} UPDATED{note}: {secs} s')
+            continue
+
+        if name not in golden:
+            print(f'[REGRESS] {name:<14} ERROR{note}: no golden, run with --update')
+            failed = True
+            continue
+
+        bad = [out for out in outputs if r['outputs'][out] != golden[name].get(out)]
+        if not bad:
+            print(f'[REGRESS] {name:<14} PASS{note}: {secs} s')
+            continue
+
+        print(f'[REGRESS] {name:<14} FAIL{note}')
+        for out in bad:
+            if out not in golden[name]:
+                print(f'    {out}: not in golden')
+            else:
+                locate(name, out, r['outputs'][out], golden[name][out], args.context_ms)
+        failed = True
+
+    if args.update:
+        with open(args.golden, 'w') as f:
+            json.dump(golden, f, indent=1)
+        print(f'[REGRESS] Saved goldens to {args.golden}')
+
+    sys.exit(1 if failed else 0)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,31 @@
+"""
+Loads tables written by the testbenches (TableWriter in sim_common.h).
+"""
+
+import os
+import numpy as np
+import pandas as pd
+
+def load_table(base):
+    """
+    Load base.npy, or base.csv when it is the newer of the two (SIM_ARGS=+csv).
+    """
+    npy = base + '.npy'
+    csv = base + '.csv'
+
+    if os.path.exists(csv) and (not os.path.exists(npy) or os.path.getmtime(csv) > os.path.getmtime(npy)):
+        return pd.read_csv(csv)
+
+    return pd.DataFrame(np.load(npy))
+
+def load_signals(path='../tmp/signals', mmap=True):
+    """
+    Load a +siglog directory (SignalLogger in sim_trace.h) as a DataFrame
+    with one row per output sample. Columns are listed in signals.txt; with
+    mmap the .npy files are memory-mapped instead of read.
+    """
+    with open(os.path.join(path, 'signals.txt')) as f:
+        names = f.read().split()
+
+    mode = 'r' if mmap else None
+    return pd.DataFrame({n: np.load(os.path.join(path, n + '.npy'), mmap_mode=mode)[n] for n in names})
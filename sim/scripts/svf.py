@@ -2,16 +2,19 @@
 Parses svf testbench output.
 """
 
+import sys
 import pandas as pd
 import numpy as np
 import matplotlib.pyplot as plt
 
+from sim_io import load_table
+
 def get_envelope(sig, window=100):
     return pd.Series(sig).abs().rolling(window=window, center=True).max()
 
 def plot_response(file):
-    name = file.split('/')[-1].split('.')[0].split('_')[-1]
-    df = pd.read_csv(file)
+    name = file.split('/')[-1].split('_')[-1]
+    df = load_table(file)
 
     input_sig = df['in_val'] / 8192.0
     output_sig = df['out_val'] / 8192.0
@@ -64,11 +67,51 @@ def plot_response(file):
     plt.savefig(f'../out/svf_{name}.png', dpi=400)
     print(f'Plotted {name}.')
 
+def plot_mls_response(file):
+    name = file.split('/')[-1].split('_')[-1]
+    df = load_table(file)
+
+    freqs = df['freq_hz']
+    gain_db = df['gain_db']
+
+    fig, ax = plt.subplots(2, 1, figsize=(12, 8))
+
+    ax[0].set_title("Magnitude")
+    ax[0].semilogx(freqs, gain_db, color='black', linewidth=2)
+
+    cutoff_freq = 1000
+    ax[0].axvline(cutoff_freq, color='black', linestyle='--', alpha=0.5, label=f"Cutoff {cutoff_freq}Hz")
+    ax[0].axhline(-3, color='black', linestyle='-', alpha=0.5, label='-3dB')
+    ax[0].set_ylabel("Magnitude [dB]")
+    ax[0].set_xlabel("Frequency [Hz]")
+    ax[0].set_ylim(-50, 5)
+    ax[0].set_xlim(20, 20000)
+    ax[0].grid(linestyle='--', which='both', alpha=0.5)
+    ax[0].legend(loc='upper right')
+
+    ax[1].set_title("Phase")
+    ax[1].semilogx(freqs, df['phase_deg'], color='black', linewidth=2)
+    ax[1].set_ylabel("Phase [deg]")
+    ax[1].set_xlabel("Frequency [Hz]")
+    ax[1].set_xlim(20, 20000)
+    ax[1].grid(linestyle='--', which='both', alpha=0.5)
+
+    fig.suptitle(f'{name.upper()} Response (MLS)')
+    plt.tight_layout()
+    plt.savefig(f'../out/svf_{name}.png', dpi=400)
+    print(f'Plotted {name}.')
+
 def main():
-    plot_response('../tmp/svf_out_lp.csv')
-    plot_response('../tmp/svf_out_bp.csv')
-    plot_response('../tmp/svf_out_hp.csv')
-    plot_response('../tmp/svf_out_br.csv')
+    if '--mls' in sys.argv:
+        for name in ['lp', 'bp', 'hp', 'br']:
+            plot_mls_response(f'../tmp/svf_resp_{name}')
+        print('Done...')
+        return
+
+    plot_response('../tmp/svf_out_lp')
+    plot_response('../tmp/svf_out_bp')
+    plot_response('../tmp/svf_out_hp')
+    plot_response('../tmp/svf_out_br')
     print('Done...')
 
 if __name__ == "__main__":
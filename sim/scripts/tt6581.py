@@ -0,0 +1,162 @@
+"""
+Python interface to the Verilated TT6581 (cpp/sim_tt6581_lib.cpp).
+
+Build the library with `make lib_tt6581`. The clock loop runs in C++ and
+Python only exchanges whole blocks of samples, so scripted tests run at the
+speed of the C++ testbenches:
+
+    from tt6581 import TT6581
+
+    sim = TT6581()
+    sim.write(0x00, 0xD6, backdoor=True)    # V1 FREQ_LO
+    sim.write(0x01, 0x1C, backdoor=True)    # V1 FREQ_HI
+    sim.write(0x1A, 0xFF)                   # Volume, through the SPI pins
+    base = sim.snapshot()
+    pcm = sim.run_samples(50000)            # 1 s of final 14-bit samples
+    sim.restore(base)
+    pdm = sim.run_samples(50000, pdm=True)  # The same second as packed PDM
+"""
+
+import ctypes
+import os
+import numpy as np
+
+LIB_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        '..', 'obj_dir', 'tt6581_lib', 'libtt6581.so')
+
+CLK_FREQ_HZ       = 50_000_000
+SAMPLE_RATE_HZ    = 50_000
+CYCLES_PER_SAMPLE = CLK_FREQ_HZ // SAMPLE_RATE_HZ
+CYCLES_PER_DAC    = 5
+
+_libs = {}
+
+def _load(path):
+    """
+    Load the shared library once per path and declare its C signatures.
+    """
+    path = os.path.abspath(path)
+    if path in _libs:
+        return _libs[path]
+
+    if not os.path.exists(path):
+        raise FileNotFoundError(f'{path} not found, build it with `make lib_tt6581`')
+
+    lib = ctypes.CDLL(path)
+    sim = ctypes.c_void_p
+    lib.tt6581_create.argtypes   = [ctypes.c_int]
+    lib.tt6581_create.restype    = sim
+    lib.tt6581_destroy.argtypes  = [sim]
+    lib.tt6581_destroy.restype   = None
+    lib.tt6581_ticks.argtypes    = [sim]
+    lib.tt6581_ticks.restype     = ctypes.c_uint64
+    lib.tt6581_write.argtypes    = [sim, ctypes.c_uint8, ctypes.c_uint8, ctypes.c_int]
+    lib.tt6581_write.restype     = None
+    lib.tt6581_run.argtypes      = [sim, ctypes.c_uint64,
+                                    ctypes.c_void_p, ctypes.c_uint64, ctypes.c_void_p]
+    lib.tt6581_run.restype       = ctypes.c_uint64
+    lib.tt6581_snapshot.argtypes = [sim]
+    lib.tt6581_snapshot.restype  = ctypes.c_int
+    lib.tt6581_restore.argtypes  = [sim, ctypes.c_int]
+    lib.tt6581_restore.restype   = ctypes.c_int
+    lib.tt6581_release.argtypes  = [sim, ctypes.c_int]
+    lib.tt6581_release.restype   = None
+
+    _libs[path] = lib
+    return lib
+
+class Snapshot:
+    """
+    Saved model state, returned by TT6581.snapshot(). Freed with the object.
+    """
+    def __init__(self, sim, sid):
+        self.sim = sim
+        self.sid = sid
+        self.ticks = sim.ticks
+
+    def __del__(self):
+        if self.sim.handle:
+            self.sim.lib.tt6581_release(self.sim.handle, self.sid)
+
+class TT6581:
+    """
+    One Verilated tt6581 model, reset on construction.
+
+    spi_div is the SPI clock divider of pin-level writes (system clocks per
+    SCLK period), 2 matches the player's stimulus playback.
+    """
+    def __init__(self, lib_path=LIB_PATH, spi_div=2):
+        self.lib = _load(lib_path)
+        self.handle = self.lib.tt6581_create(spi_div)
+
+    def close(self):
+        if self.handle:
+            self.lib.tt6581_destroy(self.handle)
+            self.handle = None
+
+    def __del__(self):
+        self.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    @property
+    def ticks(self):
+        """
+        System clocks run since construction.
+        """
+        return self.lib.tt6581_ticks(self.handle)
+
+    def write(self, addr, data, backdoor=False):
+        """
+        Write a register through the SPI pins, or with backdoor=True directly
+        into reg_file's write port (one clock instead of a whole frame).
+        """
+        self.lib.tt6581_write(self.handle, addr, data, int(backdoor))
+
+    def write_regs(self, regs, backdoor=False):
+        """
+        Write an iterable of (addr, data) pairs in order.
+        """
+        for addr, data in regs:
+            self.write(addr, data, backdoor)
+
+    def run(self, ticks):
+        """
+        Run system clocks without capturing the output.
+        """
+        self.lib.tt6581_run(self.handle, ticks, None, 0, None)
+
+    def run_samples(self, n, pdm=False):
+        """
+        Run n sample periods and return the output.
+
+        Returns the final 14-bit samples as int16, or with pdm=True the 10 MHz
+        PDM stream packed MSB-first into uint8 (the format of tmp/pdm_out.bin
+        and tmp/player_pdm.bin, 25 bytes per sample).
+        """
+        ticks = n * CYCLES_PER_SAMPLE
+        if pdm:
+            bits = np.zeros(ticks // CYCLES_PER_DAC // 8, dtype=np.uint8)
+            self.lib.tt6581_run(self.handle, ticks, None, 0, bits.ctypes.data)
+            return bits
+
+        pcm = np.zeros(n, dtype=np.int16)
+        got = self.lib.tt6581_run(self.handle, ticks, pcm.ctypes.data, n, None)
+        return pcm[:min(got, n)]
+
+    def snapshot(self):
+        """
+        Save the model state in memory.
+        """
+        return Snapshot(self, self.lib.tt6581_snapshot(self.handle))
+
+    def restore(self, snap):
+        """
+        Return the model to a snapshot taken from this instance.
+        """
+        if snap.sim is not self or self.lib.tt6581_restore(self.handle, snap.sid) != 0:
+            raise ValueError('snapshot does not belong to this model')
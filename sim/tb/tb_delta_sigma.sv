@@ -14,7 +14,10 @@ module tb_delta_sigma
   input   logic               rst_ni,
   input   logic               audio_valid_i,
   input   logic signed [13:0] audio_i,
-  output                      wave_o
+  output                      wave_o,
+
+  // Probes
+  output  logic               en_o          // Modulator clock enable (10 MHz)
 );
 
   // DUT instance
@@ -22,10 +25,12 @@ module tb_delta_sigma
     .*
   );
 
+  assign en_o = delta_sigma_inst.en;
+
   // Stimulus
   initial begin
     if ($test$plusargs("trace") != 0) begin
-      $dumpfile("logs/tb_delta_sigma.vcd");
+      $dumpfile("logs/tb_delta_sigma.fst");
       $dumpvars();
     end
 
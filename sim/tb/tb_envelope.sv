@@ -24,7 +24,11 @@ module tb_envelope (
   input   logic [3:0]   release_i,
 
   output  logic         ready_o,
-  output  logic [39:0]  prod_o
+  output  logic [39:0]  prod_o,
+
+  // Probes
+  output  logic [23:0]  env_vol_o,    // Volume of voice_idx_i (Q8.16)
+  output  logic [1:0]   env_state_o   // ADSR state of voice_idx_i
 );
 
   logic         mult_ready;
@@ -63,10 +67,13 @@ module tb_envelope (
     .prod_o       ( prod_o      )
   );
 
+  assign env_vol_o   = envelope_inst.cur_vol;
+  assign env_state_o = envelope_inst.cur_voice_state;
+
   // Stimulus
   initial begin
     if ($test$plusargs("trace") != 0) begin
-      $dumpfile("logs/tb_envelope.vcd");
+      $dumpfile("logs/tb_envelope.fst");
       $dumpvars();
     end
 
@@ -27,7 +27,7 @@ module tb_mult
     // Stimulus
     initial begin
       if ($test$plusargs("trace") != 0) begin
-        $dumpfile("logs/tb_mult.vcd");
+        $dumpfile("logs/tb_mult.fst");
         $dumpvars();
       end
 
@@ -31,7 +31,7 @@ module tb_spi (
     // Stimulus
     initial begin
       if ($test$plusargs("trace") != 0) begin
-        $dumpfile("logs/tb_spi.vcd");
+        $dumpfile("logs/tb_spi.fst");
         $dumpvars();
       end
 
@@ -0,0 +1,106 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  File: tb_spi_fuzz.sv
+//  Description: Wrapper for the SPI protocol fuzzer: the SPI block and the
+//               register file as connected in tt6581, with probes for
+//               coverage and checking.
+//
+//  Author:
+//      - Andreas Pedersen
+//
+//-------------------------------------------------------------------------------------------------
+
+module tb_spi_fuzz (
+  input   logic         clk_i,            // System clock (50 MHz)
+  input   logic         rst_ni,           // Active low reset
+
+  input   logic         sclk_i,           // SPI Clock
+  input   logic         cs_i,             // SPI Chip select
+  input   logic         mosi_i,           // SPI MOSI
+  output  logic         miso_o,           // SPI MISO
+
+  // Probes
+  output  logic         reg_we_o,         // Register write strobe
+  output  logic [6:0]   reg_addr_o,       // Register address
+  output  logic [7:0]   reg_wdata_o,      // Register write data
+  output  logic [3:0]   bit_cnt_o,        // SPI bit counter
+  output  logic         is_write_o,       // Latched command bit
+  output  logic         cs_active_o,      // Synchronized chip select active
+  output  logic [2:0]   sclk_sync_o,      // SCLK synchronizer
+  output  logic [7:0]   regs_o [27]       // Register file contents, by address
+);
+
+  logic [7:0]   reg_rdata;
+
+  logic [23:0]  freq_lo_pack;
+  logic [23:0]  freq_hi_pack;
+  logic [23:0]  pw_lo_pack;
+  logic [23:0]  pw_hi_pack;
+  logic [23:0]  control_pack;
+  logic [23:0]  ad_pack;
+  logic [23:0]  sr_pack;
+
+  // DUT instances
+  spi spi_inst (
+    .clk_i        ( clk_i       ),
+    .rst_ni       ( rst_ni      ),
+    .sclk_i       ( sclk_i      ),
+    .cs_i         ( cs_i        ),
+    .mosi_i       ( mosi_i      ),
+    .miso_o       ( miso_o      ),
+    .reg_rdata_i  ( reg_rdata   ),
+    .reg_wdata_o  ( reg_wdata_o ),
+    .reg_addr_o   ( reg_addr_o  ),
+    .reg_we_o     ( reg_we_o    )
+  );
+
+  reg_file reg_file_inst (
+    .clk_i              ( clk_i         ),
+    .rst_ni             ( rst_ni        ),
+    .addr_i             ( reg_addr_o    ),
+    .wdata_i            ( reg_wdata_o   ),
+    .we_i               ( reg_we_o      ),
+    .rdata_o            ( reg_rdata     ),
+
+    .voice_freq_lo_o    ( freq_lo_pack  ),
+    .voice_freq_hi_o    ( freq_hi_pack  ),
+    .voice_pw_lo_o      ( pw_lo_pack    ),
+    .voice_pw_hi_o      ( pw_hi_pack    ),
+    .voice_control_o    ( control_pack  ),
+    .voice_ad_o         ( ad_pack       ),
+    .voice_sr_o         ( sr_pack       ),
+
+    .filter_f_lo_o      ( regs_o[21]    ),
+    .filter_f_hi_o      ( regs_o[22]    ),
+    .filter_q_lo_o      ( regs_o[23]    ),
+    .filter_q_hi_o      ( regs_o[24]    ),
+    .filter_en_mode_o   ( regs_o[25]    ),
+    .filter_volume_o    ( regs_o[26]    )
+  );
+
+  // Voice registers: 7 per voice, voice v in byte v of each pack
+  for (genvar v = 0; v < 3; v++) begin : gen_voice_regs
+    assign regs_o[7*v + 0] = freq_lo_pack[8*v +: 8];
+    assign regs_o[7*v + 1] = freq_hi_pack[8*v +: 8];
+    assign regs_o[7*v + 2] = pw_lo_pack[8*v +: 8];
+    assign regs_o[7*v + 3] = pw_hi_pack[8*v +: 8];
+    assign regs_o[7*v + 4] = control_pack[8*v +: 8];
+    assign regs_o[7*v + 5] = ad_pack[8*v +: 8];
+    assign regs_o[7*v + 6] = sr_pack[8*v +: 8];
+  end
+
+  assign bit_cnt_o   = spi_inst.bit_cnt;
+  assign is_write_o  = spi_inst.is_write_cmd;
+  assign cs_active_o = spi_inst.cs_active;
+  assign sclk_sync_o = spi_inst.sclk_sync;
+
+  // Stimulus
+  initial begin
+    // Only a single replayed input is dumped, never a whole fuzzing run
+    if ($test$plusargs("trace") != 0 && $test$plusargs("replay") != 0) begin
+      $dumpfile("logs/tb_spi_fuzz.fst");
+      $dumpvars();
+    end
+  end
+
+endmodule
@@ -61,7 +61,7 @@ module tb_svf (
   // Stimulus
   initial begin
     if ($test$plusargs("trace") != 0) begin
-      $dumpfile("logs/tb_svf.vcd");
+      $dumpfile("logs/tb_svf.fst");
       $dumpvars();
     end
 
@@ -1,7 +1,8 @@
 //-------------------------------------------------------------------------------------------------
 //
 //  File: tb_tt6581.sv
-//  Description: Wrapper for Verilator testbench.
+//  Description: Wrapper for the tt6581 Verilator testbench, shared by the
+//               song, player and bode modes.
 //
 //  Author:
 //      - Andreas Pedersen
@@ -15,7 +16,39 @@ module tb_tt6581 (
   input   logic       cs_i,       // SPI Chip select
   input   logic       mosi_i,     // SPI MOSI
   output  logic       miso_o,     // SPI MISO
-  output  logic       wave_o
+  output  logic       wave_o,
+
+  // Probes
+  output  logic        sample_tick_o,   // 50 kHz sample tick
+  output  logic        audio_valid_o,   // Controller output sample valid
+  output  logic [3:0]  ctrl_state_o,    // Controller FSM state
+  output  logic [1:0]  ctrl_voice_o,    // Voice being processed
+  output  logic [1:0]  env_state_o,     // Envelope FSM state
+  output  logic [3:0]  svf_state_o,     // SVF FSM state
+  output  logic        mult_busy_o,     // Multiplier iterating
+  output  logic [1:0]  mult_mux_o,      // Multiplier input select (0: env, 1: svf, 2: vol)
+  output  logic [39:0] mult_prod_o,     // Multiplier product
+  output  logic [13:0] mult_out_o,      // Product slice into the accumulators
+  output  logic        accum_en_o,      // Accumulate mult_out this cycle
+  output  logic        accum_mux_o,     // 0: bypass, 1: filter accumulator
+  output  logic [13:0] bypass_accum_o,  // Unfiltered voice sum
+  output  logic [13:0] filter_accum_o,  // Filtered voice sum (SVF input)
+  output  logic [23:0] svf_hp_o,        // SVF high-pass node
+  output  logic [23:0] svf_band_o,      // SVF band-pass state
+  output  logic [23:0] svf_low_o,       // SVF low-pass state
+  output  logic [23:0] svf_sel_o,       // SVF output before saturation
+  output  logic [13:0] svf_out_o,       // SVF output
+  output  logic        spi_active_o,    // Synchronized chip select active
+  output  logic        reg_we_o,        // Register write strobe
+  output  logic [6:0]  reg_addr_o,
+  output  logic [7:0]  reg_wdata_o,
+  output  logic [18:0] phase0_o,        // Voice phase accumulators
+  output  logic [18:0] phase1_o,
+  output  logic [18:0] phase2_o,
+  output  logic [23:0] vol0_o,          // Voice envelope levels (Q8.16)
+  output  logic [23:0] vol1_o,
+  output  logic [23:0] vol2_o,
+  output  logic [5:0]  adsr_o           // Voice ADSR states, 2 bits per voice
 );
 
     // DUT instance
@@ -29,13 +62,41 @@ module tb_tt6581 (
     .wave_o ( wave_o  )
   );
 
-    // Stimulus
-    initial begin
-      if ($test$plusargs("trace") != 0) begin
-        $dumpfile("logs/tb_tt6581.vcd");
-        $dumpvars();
-      end
+  assign sample_tick_o  = tt6581_inst.sample_tick;
+  assign audio_valid_o  = tt6581_inst.audio_valid;
+  assign ctrl_state_o   = tt6581_inst.controller_inst.cur_state;
+  assign ctrl_voice_o   = tt6581_inst.controller_inst.cur_voice;
+  assign env_state_o    = tt6581_inst.envelope_inst.cur_state;
+  assign svf_state_o    = tt6581_inst.svf_inst.cur_state;
+  assign mult_busy_o    = tt6581_inst.mult_inst.cur_state;
+  assign mult_mux_o     = tt6581_inst.mult_in_mux;
+  assign mult_prod_o    = tt6581_inst.mult_product;
+  assign mult_out_o     = tt6581_inst.mult_out;
+  assign accum_en_o     = tt6581_inst.accum_en;
+  assign accum_mux_o    = tt6581_inst.accum_in_mux;
+  assign bypass_accum_o = tt6581_inst.bypass_accum;
+  assign filter_accum_o = tt6581_inst.filter_accum;
+  assign svf_hp_o       = tt6581_inst.svf_inst.hp_node;
+  assign svf_band_o     = tt6581_inst.svf_inst.reg_band;
+  assign svf_low_o      = tt6581_inst.svf_inst.reg_low;
+  assign svf_sel_o      = tt6581_inst.svf_inst.selected_out;
+  assign svf_out_o      = tt6581_inst.svf_out;
+  assign spi_active_o   = tt6581_inst.spi_inst.cs_active;
+  assign reg_we_o       = tt6581_inst.reg_we;
+  assign reg_addr_o     = tt6581_inst.reg_addr;
+  assign reg_wdata_o    = tt6581_inst.reg_wdata;
+  assign phase0_o       = tt6581_inst.multi_voice_inst.phase_regs[0];
+  assign phase1_o       = tt6581_inst.multi_voice_inst.phase_regs[1];
+  assign phase2_o       = tt6581_inst.multi_voice_inst.phase_regs[2];
+  assign vol0_o         = tt6581_inst.envelope_inst.vol_regs[0];
+  assign vol1_o         = tt6581_inst.envelope_inst.vol_regs[1];
+  assign vol2_o         = tt6581_inst.envelope_inst.vol_regs[2];
+  assign adsr_o         = {tt6581_inst.envelope_inst.voice_states[2],
+                           tt6581_inst.envelope_inst.voice_states[1],
+                           tt6581_inst.envelope_inst.voice_states[0]};
 
+    // Waveforms are dumped from the harness (WaveTrace in sim_trace.h)
+    initial begin
       $display("[%0t] Starting simulation...", $time);
     end
 
@@ -0,0 +1,59 @@
+//-------------------------------------------------------------------------------------------------
+//
+//  File: tb_voice.sv
+//  Description: Wrapper for Verilator testbench.
+//
+//  Author:
+//      - Andreas Pedersen
+//
+//-------------------------------------------------------------------------------------------------
+
+module tb_voice (
+  input   logic         clk_i,
+  input   logic         rst_ni,
+  input   logic         start_i,        // Start processing act_voice_i
+
+  input   logic [1:0]   act_voice_i,    // Active voice [0-2]
+  input   logic [15:0]  freq_word_i,
+  input   logic [11:0]  pw_word_i,
+  input   logic [3:0]   wave_sel_i,
+  input   logic         sync_i,
+  input   logic         ring_mod_i,
+
+  output  logic         ready_o,
+  output  logic [9:0]   wave_o,
+
+  // Probes
+  output  logic [18:0]  phase_o,        // Phase of act_voice_i
+  output  logic [22:0]  lfsr_o          // Noise LFSR of act_voice_i
+);
+
+  // DUT instance
+  multi_voice multi_voice_inst (
+    .clk_i        ( clk_i       ),
+    .rst_ni       ( rst_ni      ),
+    .start_i      ( start_i     ),
+    .act_voice_i  ( act_voice_i ),
+    .freq_word_i  ( freq_word_i ),
+    .pw_word_i    ( pw_word_i   ),
+    .wave_sel_i   ( wave_sel_i  ),
+    .sync_i       ( sync_i      ),
+    .ring_mod_i   ( ring_mod_i  ),
+    .ready_o      ( ready_o     ),
+    .wave_o       ( wave_o      )
+  );
+
+  assign phase_o = multi_voice_inst.phase_regs[act_voice_i];
+  assign lfsr_o  = multi_voice_inst.lfsr_regs[act_voice_i];
+
+  // Stimulus
+  initial begin
+    if ($test$plusargs("trace") != 0) begin
+      $dumpfile("logs/tb_voice.fst");
+      $dumpvars();
+    end
+
+    $display("[%0t] Starting simulation...", $time);
+  end
+
+endmodule
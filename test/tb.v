@@ -30,4 +30,51 @@ module tb ();
     .rst_n  (rst_n)     // not reset
   );
 
+  // Fast audio capture (capture_audio / capture_pcm in tt6581_tb/signals.py).
+  // The PDM output is sampled every CAP_PDM_DIV clocks and packed into one
+  // CAP_PDM_BITS-bit word per audio sample, first bit in the MSB. Words go
+  // into a ring of CAP_DEPTH entries, so Python waits once per batch and
+  // reads whole words instead of awaiting every PDM bit.
+  localparam CAP_PDM_DIV  = 5;      // 50 MHz / 5 = 10 MHz PDM
+  localparam CAP_PDM_BITS = 200;    // PDM bits per 50 kHz audio sample
+  localparam CAP_DEPTH    = 4096;   // Ring entries (82 ms of audio)
+
+  reg [2:0]              cap_div   = 0;
+  reg [7:0]              cap_bit   = 0;
+  reg [CAP_PDM_BITS-1:0] cap_shift = 0;
+  reg [31:0]             cap_count = 0;   // PDM words written
+  reg [CAP_PDM_BITS-1:0] cap_pdm [0:CAP_DEPTH-1];
+
+  wire [CAP_PDM_BITS-1:0] cap_next = {cap_shift[CAP_PDM_BITS-2:0], uo_out[0] === 1'b1};
+
+  always @(posedge clk) begin
+    if (cap_div == CAP_PDM_DIV - 1) begin
+      cap_div   <= 0;
+      cap_shift <= cap_next;
+      if (cap_bit == CAP_PDM_BITS - 1) begin
+        cap_bit   <= 0;
+        cap_pdm[cap_count % CAP_DEPTH] <= cap_next;
+        cap_count <= cap_count + 1;
+      end else begin
+        cap_bit <= cap_bit + 1;
+      end
+    end else begin
+      cap_div <= cap_div + 1;
+    end
+  end
+
+`ifndef GL_TEST
+  // Final 14-bit samples (the delta-sigma input), one per audio_valid.
+  // RTL only: the gate-level netlist has no hierarchy to tap.
+  reg [31:0] cap_pcm_count = 0;   // PCM samples written
+  reg [13:0] cap_pcm [0:CAP_DEPTH-1];
+
+  always @(posedge clk) begin
+    if (tt6581.tt6581_inst.audio_valid) begin
+      cap_pcm[cap_pcm_count % CAP_DEPTH] <= tt6581.tt6581_inst.mult_out;
+      cap_pcm_count <= cap_pcm_count + 1;
+    end
+  end
+`endif
+
 endmodule
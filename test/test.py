@@ -11,7 +11,7 @@ from tt6581_tb import (
     V0_BASE, V1_BASE, V2_BASE, WAVE_TRI, WAVE_SAW, WAVE_PULSE, WAVE_NOISE, WAVEFORM_NAMES,
     FILT_LP, FILT_HP, FILT_BP, FILT_BR, FILT_V0, SAMPLE_RATE,
     # voice helpers
-    setup_voice, gate_on, gate_off, set_volume,
+    setup_voice, gate_on, gate_off, set_volume, settle_envelope,
     # signal / capture
     reset_dut, capture_audio,
     # plotting
@@ -46,7 +46,7 @@ async def test_waveforms(dut):
         await gate_on(dut, V0_BASE, wave_mask)
 
         # Let the envelope reach sustain before capturing
-        await ClockCycles(dut.clk, 500000)
+        await settle_envelope(dut, V0_BASE, sustain=0xF)
 
         samples = await capture_audio(dut, num_samples=500)
         dut._log.info(f"[TB] Captured {len(samples)} samples for {wave_name}")
@@ -100,8 +100,8 @@ async def test_frequencies(dut):
                           attack=0, decay=0, sustain=0xF, release=0)
         await gate_on(dut, V2_BASE, WAVE_TRI)
 
-        # Let the envelope reach sustain before capturing
-        await ClockCycles(dut.clk, 500000)
+        # Let the envelopes reach sustain before capturing
+        await settle_envelope(dut, V0_BASE, V1_BASE, V2_BASE, sustain=0xF)
 
         samples = await capture_audio(dut, num_samples=5000)
         dut._log.info(f"[TB] Captured {len(samples)} samples for frequencies: {f}")
@@ -13,6 +13,14 @@ TB_OUTPUT_DIR = os.path.join(os.path.dirname(__file__), "..", "tmp")
 TB_OUTPUT_DIR = os.path.normpath(TB_OUTPUT_DIR)
 os.makedirs(TB_OUTPUT_DIR, exist_ok=True)
 
+#==================================
+# Fast mode
+#==================================
+# TT6581_FAST=1 (make FAST=1) writes registers through the reg_file backdoor
+# and preloads envelopes instead of waiting for them to settle. RTL only;
+# tests that exercise the SPI pins call spi_write directly.
+FAST_MODE = os.environ.get("TT6581_FAST", "0") == "1"
+
 #==================================
 # Clocking
 #==================================
@@ -26,6 +34,10 @@ PDM_RATE    = SYS_CLK_HZ // PDM_CLK_DIV     # 10 MHz
 FILT_ORDER  = 4                             # Butterworth filter order
 FILT_CUTOFF = 20_000                        # Output low-pass cutoff
 
+# Capture rings in tb.v (must match its CAP_* localparams)
+CAP_PDM_BITS = PDM_RATE // SAMPLE_RATE      # 200 PDM bits per audio sample
+CAP_DEPTH    = 4096                         # Ring entries
+
 #==================================
 # Voice register offset
 #==================================
@@ -44,6 +56,16 @@ V0_BASE = 0x00
 V1_BASE = 0x07
 V2_BASE = 0x0E
 
+#==================================
+# Envelope states (envelope.sv)
+#==================================
+ENV_ATTACK  = 0
+ENV_DECAY   = 1
+ENV_SUSTAIN = 2
+ENV_RELEASE = 3
+
+ENV_FSM_ADSR = 1    # Master FSM state that updates the current voice
+
 #==================================
 # Filter addresses
 #==================================
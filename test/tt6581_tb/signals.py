@@ -7,7 +7,8 @@ from scipy.signal import butter, bessel, sosfilt
 from cocotb.triggers import ClockCycles
 
 from .constants import (
-    PDM_CLK_DIV, PDM_RATE, FILT_ORDER, FILT_CUTOFF, SAMPLE_RATE,
+    PDM_RATE, FILT_ORDER, FILT_CUTOFF, SAMPLE_RATE, SYS_CLK_HZ,
+    CAP_PDM_BITS, CAP_DEPTH,
 )
 
 #==================================
@@ -24,30 +25,53 @@ async def reset_dut(dut, cycles: int = 10):
     await ClockCycles(dut.clk, cycles)
 
 
+#==================================
+# Capture rings (tb.v)
+#==================================
+async def read_capture(dut, mem, count, num: int, log_every: int = 0,
+                       name: str = "") -> list[int]:
+    """
+    Wait for *num* new words of a tb.v capture ring and return them.
+
+    The rings fill at one word per audio sample. Up to half a ring is
+    awaited at once and then read back, so no word is overwritten before
+    it is read and Python only wakes up once per batch.
+    """
+    period = SYS_CLK_HZ // SAMPLE_RATE
+    words  = []
+    start  = int(count.value)
+
+    while len(words) < num:
+        batch = min(num - len(words), CAP_DEPTH // 2)
+        await ClockCycles(dut.clk, batch * period)
+        end = int(count.value)
+        words.extend(int(mem[k % CAP_DEPTH].value) for k in range(start, end))
+        start = end
+
+        if log_every:
+            dut._log.info(f"[{name}] {min(len(words), num)}/{num} audio samples captured")
+
+    return words[:num]
+
+
 #==================================
 # Delta-Sigma capture
 #==================================
 async def capture_audio(dut, num_samples: int = 500,
                         log_every: int = 100) -> list[float]:
     """
-    Capture audio by sampling the 1-bit PDM output and reconstructing
-    the analog waveform with a 4th order Butterworth low-pass filter.
+    Capture audio from the 1-bit PDM output and reconstruct the analog
+    waveform with a 4th order Bessel low-pass filter.
+
+    The bits are packed by the capture ring in tb.v, one 200-bit word per
+    audio sample, so this also works on the gate-level netlist.
     """
     decimation = PDM_RATE // SAMPLE_RATE
-    num_pdm    = num_samples * decimation
-    pdm_bits   = np.empty(num_pdm, dtype=np.float32)
-
-    for i in range(num_pdm):
-        await ClockCycles(dut.clk, PDM_CLK_DIV)
-        try:
-            pdm_bits[i] = 1.0 if str(dut.uo_out.value)[-1] == '1' else 0.0
-        except (ValueError, IndexError):
-            pdm_bits[i] = 0.0
-
-        if log_every and (i + 1) % (log_every * decimation) == 0:
-            n = (i + 1) // decimation
-            dut._log.info(f"[PDM] {n}/{num_samples} audio samples captured")
+    words = await read_capture(dut, dut.cap_pdm, dut.cap_count, num_samples,
+                               log_every, "PDM")
 
+    packed   = b"".join(w.to_bytes(CAP_PDM_BITS // 8, "big") for w in words)
+    pdm_bits = np.unpackbits(np.frombuffer(packed, dtype=np.uint8)).astype(np.float32)
     pdm_bits = pdm_bits * 2.0 - 1.0
 
     sos = bessel(FILT_ORDER, FILT_CUTOFF, btype='low', fs=PDM_RATE, output='sos')
@@ -57,3 +81,12 @@ async def capture_audio(dut, num_samples: int = 500,
     audio = filtered[::decimation]
 
     return audio.tolist()
+
+
+async def capture_pcm(dut, num_samples: int = 500) -> list[int]:
+    """
+    Capture the final signed 14-bit samples (the delta-sigma input) from
+    the PCM ring in tb.v. RTL only.
+    """
+    words = await read_capture(dut, dut.cap_pcm, dut.cap_pcm_count, num_samples)
+    return [w - (1 << 14) if w & (1 << 13) else w for w in words]
@@ -2,15 +2,102 @@
 Voice and filter programming helpers.
 """
 
+from cocotb.triggers import ClockCycles, FallingEdge
+
 from .constants import (
     REG_FREQ_LO, REG_FREQ_HI, REG_PW_LO, REG_PW_HI,
     REG_CTRL, REG_AD, REG_SR,
     REG_FILT_F_LO, REG_FILT_F_HI, REG_FILT_Q_LO, REG_FILT_Q_HI,
     REG_FILT_ENMOD, REG_FILT_VOL,
+    V1_BASE, ENV_SUSTAIN, ENV_FSM_ADSR, FAST_MODE,
+    SYS_CLK_HZ, SAMPLE_RATE,
     calc_fcw, get_coeff_f, get_coeff_q,
 )
 from .spi import spi_write
 
+#==================================
+# Backdoor access
+#==================================
+_fast_warned = False
+
+def rtl_core(dut):
+    """
+    Return the tt6581 core instance, or None on the gate-level netlist.
+    """
+    try:
+        return dut.tt6581.tt6581_inst
+    except AttributeError:
+        return None
+
+def fast_mode(dut) -> bool:
+    """
+    True when FAST_MODE is set and the design hierarchy is accessible.
+    """
+    global _fast_warned
+    if not FAST_MODE:
+        return False
+    if rtl_core(dut) is None:
+        if not _fast_warned:
+            dut._log.warning("[TB] TT6581_FAST needs the RTL hierarchy, using SPI")
+            _fast_warned = True
+        return False
+    return True
+
+async def reg_write(dut, addr: int, data: int):
+    """
+    Write a register.
+
+    In fast mode the SPI block's address, data and write strobe registers
+    are loaded directly, so reg_file takes the write on the next clock edge
+    instead of after a 16-bit frame. Otherwise the frame is shifted in.
+    """
+    if not fast_mode(dut):
+        await spi_write(dut, addr, data)
+        return
+
+    spi = rtl_core(dut).spi_inst
+    await FallingEdge(dut.clk)
+    spi.reg_addr_o.value  = addr & 0x7F
+    spi.reg_wdata_o.value = data & 0xFF
+    spi.reg_we_o.value    = 1
+    await FallingEdge(dut.clk)
+
+async def preload_envelope(dut, voice_base: int, state: int, level: int):
+    """
+    Load a voice's ADSR state and 24-bit Q8.16 level into the envelope
+    generator. RTL only.
+
+    The load waits for a clock where the envelope is not updating a voice,
+    so it is not overwritten by that update.
+    """
+    env   = rtl_core(dut).envelope_inst
+    voice = voice_base // V1_BASE
+
+    await FallingEdge(dut.clk)
+    while int(env.cur_state.value) == ENV_FSM_ADSR:
+        await FallingEdge(dut.clk)
+
+    env.voice_states[voice].value = state
+    env.vol_regs[voice].value     = level & 0xFFFFFF
+
+async def settle_envelope(dut, *voice_bases: int, sustain: int = 0xF,
+                          cycles: int = 500000):
+    """
+    Bring gated voices to their sustain level before a capture.
+
+    In fast mode each envelope is preloaded to SUSTAIN and the output gets
+    two samples to pick it up; otherwise this waits *cycles* clocks for
+    attack and decay to finish.
+    """
+    if not fast_mode(dut):
+        await ClockCycles(dut.clk, cycles)
+        return
+
+    sustain_vol = ((sustain & 0xF) * 0x11) << 16
+    for voice_base in voice_bases:
+        await preload_envelope(dut, voice_base, ENV_SUSTAIN, sustain_vol)
+    await ClockCycles(dut.clk, 2 * SYS_CLK_HZ // SAMPLE_RATE)
+
 #==================================
 # Voice functions
 #==================================
@@ -19,15 +106,15 @@ async def set_voice_freq(dut, voice_base: int, freq_hz: float):
     Program the frequency control word for a voice.
     """
     fcw = calc_fcw(freq_hz)
-    await spi_write(dut, voice_base + REG_FREQ_LO, fcw & 0xFF)
-    await spi_write(dut, voice_base + REG_FREQ_HI, (fcw >> 8) & 0xFF)
+    await reg_write(dut, voice_base + REG_FREQ_LO, fcw & 0xFF)
+    await reg_write(dut, voice_base + REG_FREQ_HI, (fcw >> 8) & 0xFF)
 
 async def set_voice_pw(dut, voice_base: int, pw: int):
     """
     Program the 12-bit pulse width for a voice.
     """
-    await spi_write(dut, voice_base + REG_PW_LO, pw & 0xFF)
-    await spi_write(dut, voice_base + REG_PW_HI, (pw >> 8) & 0x0F)
+    await reg_write(dut, voice_base + REG_PW_LO, pw & 0xFF)
+    await reg_write(dut, voice_base + REG_PW_HI, (pw >> 8) & 0x0F)
 
 async def set_voice_adsr(dut, voice_base: int,
                          attack: int, decay: int,
@@ -37,8 +124,8 @@ async def set_voice_adsr(dut, voice_base: int,
     """
     ad = ((attack & 0x0F) << 4) | (decay & 0x0F)
     sr = ((sustain & 0x0F) << 4) | (release & 0x0F)
-    await spi_write(dut, voice_base + REG_AD, ad)
-    await spi_write(dut, voice_base + REG_SR, sr)
+    await reg_write(dut, voice_base + REG_AD, ad)
+    await reg_write(dut, voice_base + REG_SR, sr)
 
 async def set_voice_control(dut, voice_base: int,
                             waveform: int, gate: bool,
@@ -56,7 +143,7 @@ async def set_voice_control(dut, voice_base: int,
         ctrl |= 0x02
     if ring_mod:
         ctrl |= 0x04
-    await spi_write(dut, voice_base + REG_CTRL, ctrl)
+    await reg_write(dut, voice_base + REG_CTRL, ctrl)
 
 
 async def setup_voice(dut, voice_base: int, freq_hz: float,
@@ -88,4 +175,4 @@ async def set_volume(dut, vol: int):
     """
     Set the volume register.
     """
-    await spi_write(dut, REG_FILT_VOL, vol & 0xFF)
+    await reg_write(dut, REG_FILT_VOL, vol & 0xFF)